@@ -0,0 +1,46 @@
+// Benchmarks the WiFi, weather and NTP path against the local stand-in
+// servers in extras/tools/netbench.py and prints the results over Serial.
+// WiFi credentials are the ones saved with "Setup WiFi" from the menu.
+
+#include <Watchy.h>
+#include "settings.h"
+
+Watchy watchy(settings);
+
+void printStats(const char *label, uint32_t ms) {
+  Serial.printf("%-8s %5ums radio=%ums tx_payload=%uB rx_payload=%uB "
+                "parse=%uus http_err=%u ntp=%u/%u rtt=%dus\n",
+                label, ms, networkStats.radioOnMs, networkStats.payloadSent,
+                networkStats.payloadReceived, networkStats.parseUs,
+                networkStats.httpErrors,
+                networkStats.ntpSamples - networkStats.ntpFailures,
+                networkStats.ntpSamples, networkStats.ntpDelayUs);
+}
+
+void setup() {
+  Serial.begin(115200);
+  #ifdef ARDUINO_ESP32S3_DEV
+  Wire.begin(WATCHY_V3_SDA, WATCHY_V3_SCL);
+  #else
+  Wire.begin(SDA, SCL);
+  #endif
+  Watchy::RTC.init();
+  memset(&networkStats, 0, sizeof(networkStats));
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    uint32_t start = millis();
+    // One session: connects, fetches the weather, syncs NTP, radio off.
+    // WIFI_CONFIGURED holds the result of its connect.
+    watchy.getWeatherData();
+    uint32_t ms = millis() - start;
+    if (!WIFI_CONFIGURED) {
+      printStats("connect!", ms);
+      continue;
+    }
+    Serial.printf("connect  %5ums\n", networkStats.connectMs);
+    printStats("weather", ms);
+  }
+  Serial.println("done");
+}
+
+void loop() {}
@@ -0,0 +1,23 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+// Address of the machine running extras/tools/netbench.py
+#define NETBENCH_HOST "192.168.1.10"
+
+#define WEATHER_URL "http://" NETBENCH_HOST ":8080/data/2.5/weather?id={cityID}&lang={lang}&units={units}&appid={apiKey}"
+#define NTP_SERVER  NETBENCH_HOST ":1123"
+#define ITERATIONS  20
+
+watchySettings settings{
+    .cityID = "2950159",
+    .weatherAPIKey = "netbench",
+    .weatherURL = WEATHER_URL,
+    .weatherUnit = "metric",
+    .weatherLang = "en",
+    .weatherUpdateInterval = 0, // fetch on every call
+    .ntpServer = NTP_SERVER,
+    .gmtOffset = 0,
+    .vibrateOClock = false,
+};
+
+#endif
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Collect Watchy telemetry beacons (src/BLEBeacon.h) without connecting.
+
+    pip install bleak
+    python3 beacon_decode.py                  # print beacons as they come
+    python3 beacon_decode.py --csv fleet.csv  # also append them to a file
+    python3 beacon_decode.py --hex 5701...    # decode one payload
+
+Set settings.beaconInterval on the watches; each broadcast lasts about
+100 ms, so keep this running to catch them. Repeats of the same sequence
+number from one watch are dropped.
+"""
+
+import argparse
+import asyncio
+import csv
+import struct
+import sys
+import time
+
+COMPANY_ID = 0xFFFF
+FIELDS = ("address", "rssi", "battery", "steps", "sync_age_min", "firmware",
+          "sequence")
+
+
+def decode(payload):
+    """Decodes manufacturer data after the company id, None if not ours."""
+    if len(payload) < 13 or payload[0:1] != b"W" or payload[1] != 1:
+        return None
+    battery, steps, sync_age = struct.unpack("<BIH", payload[2:9])
+    major, minor, patch, sequence = payload[9:13]
+    return {"battery": battery, "steps": steps,
+            "sync_age_min": None if sync_age == 0xFFFF else sync_age,
+            "firmware": f"{major}.{minor}.{patch}", "sequence": sequence}
+
+
+async def scan(args):
+    from bleak import BleakScanner
+
+    seen = {}
+    writer = None
+    if args.csv:
+        handle = open(args.csv, "a", newline="")
+        writer = csv.DictWriter(handle, fieldnames=("time",) + FIELDS)
+        if handle.tell() == 0:
+            writer.writeheader()
+
+    def found(device, advertisement):
+        payload = advertisement.manufacturer_data.get(COMPANY_ID)
+        beacon = decode(payload) if payload else None
+        if beacon is None or seen.get(device.address) == beacon["sequence"]:
+            return
+        seen[device.address] = beacon["sequence"]
+        beacon.update(address=device.address, rssi=advertisement.rssi)
+        age = beacon["sync_age_min"]
+        print(f"{device.address} {advertisement.rssi:4d} dBm  "
+              f"battery {beacon['battery']:3d}%  steps {beacon['steps']:6d}  "
+              f"synced {'never' if age is None else f'{age} min ago'}  "
+              f"fw {beacon['firmware']}  #{beacon['sequence']}")
+        if writer:
+            writer.writerow(dict(beacon, time=int(time.time())))
+            handle.flush()
+
+    async with BleakScanner(found):
+        await asyncio.sleep(args.duration or 1e9)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--csv", help="append decoded beacons to this file")
+    parser.add_argument("--duration", type=float, default=0,
+                        help="seconds to scan, 0 runs until interrupted")
+    parser.add_argument("--hex", help="decode a manufacturer data payload "
+                        "(after the company id) and exit")
+    args = parser.parse_args()
+    if args.hex:
+        beacon = decode(bytes.fromhex(args.hex))
+        if beacon is None:
+            sys.exit("not a Watchy beacon")
+        print(beacon)
+        return
+    try:
+        asyncio.run(scan(args))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
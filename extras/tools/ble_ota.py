@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""Upload firmware to Watchy over BLE.
+
+    pip install bleak
+    python3 ble_ota.py build/Watchy.ino.bin
+
+Packed (ota_pack.py) and delta (ota_delta.py) images are uploaded the same
+way; the watch recognises them by their header.
+
+Open "Update Firmware" on the watch first. The default framed protocol
+(see src/BLE.cpp) sends the image size and SHA-256 up front, numbers and
+CRCs every packet, and resumes from the watch's offset after a dropped
+connection, also on a later run with the same image. --protocol stream uses
+the plain write-without-response stream instead. --window must match
+BLE_ACK_WINDOW in src/config.h.
+"""
+
+import argparse
+import asyncio
+import hashlib
+import struct
+import sys
+import time
+import zlib
+
+from bleak import BleakClient, BleakScanner
+from bleak.exc import BleakError
+
+SERVICE_ESPOTA = "cd77498e-1ac8-48b6-aba8-4161c7342fce"
+CHAR_STREAM = "86b12869-4b70-4893-8ce6-9864fc00374d"
+CHAR_FRAMED = "86b1286a-4b70-4893-8ce6-9864fc00374d"
+MAX_PACKET = 512
+
+BEGIN, DATA, END = 1, 2, 3
+OK, CRC_ERROR, SEQ_ERROR, DONE, VERIFYING = 0, 1, 2, 7, 9
+STATUS = {0: "ok", 1: "crc error", 2: "sequence error", 3: "size error",
+          4: "verification failed", 5: "flash error", 6: "not started",
+          7: "done", 8: "delta does not match the running firmware",
+          9: "verifying"}
+
+
+class Failed(Exception):
+    pass
+
+
+async def find(name):
+    device = await BleakScanner.find_device_by_filter(
+        lambda d, ad: d.name == name or SERVICE_ESPOTA in ad.service_uuids,
+        timeout=20)
+    if device is None:
+        raise Failed(f"no device advertising {name!r}")
+    return device
+
+
+def progress(done, total, start):
+    rate = done / max(time.monotonic() - start, 1e-3) / 1024
+    print(f"\r{done}/{total} bytes {rate:.1f} KiB/s", end="", flush=True)
+
+
+async def upload_stream(client, args, image):
+    packet = min(MAX_PACKET, client.mtu_size - 3)
+    acks = asyncio.Queue()
+    await client.start_notify(
+        CHAR_STREAM,
+        lambda _, data: acks.put_nowait(struct.unpack("<I", data[:4])[0]))
+
+    async def wait_ack(expected):
+        acked = await asyncio.wait_for(acks.get(), args.timeout)
+        if acked != expected:
+            raise Failed(f"watch accepted {acked} of {expected} bytes")
+
+    chunks = [image[i:i + packet] for i in range(0, len(image), packet)]
+    if len(image) % packet == 0 or len(chunks) == 1:
+        chunks.append(b"")  # a packet shorter than the first ends it
+    start = time.monotonic()
+    sent = 0
+    for index, chunk in enumerate(chunks):
+        await client.write_gatt_char(CHAR_STREAM, chunk, response=False)
+        sent += len(chunk)
+        if (index + 1) % args.window == 0 and len(chunk) == packet:
+            await wait_ack(sent)
+            progress(sent, len(image), start)
+    await wait_ack(sent)
+
+
+async def upload_framed(client, args, image):
+    payload = min(MAX_PACKET, client.mtu_size - 3) - 7
+    replies = asyncio.Queue()
+    await client.start_notify(
+        CHAR_FRAMED,
+        lambda _, data: replies.put_nowait(struct.unpack("<BHI", data[:7])))
+
+    async def reply():
+        return await asyncio.wait_for(replies.get(), args.timeout)
+
+    async def begin():
+        """(Re)announces the image, returns the offset to send from."""
+        while not replies.empty():
+            replies.get_nowait()
+        await client.write_gatt_char(
+            CHAR_FRAMED,
+            struct.pack("<BI", BEGIN, len(image)) +
+            hashlib.sha256(image).digest(), response=True)
+        code, _, offset = await reply()
+        if code != OK:
+            raise Failed(f"begin: {STATUS.get(code, code)}")
+        return offset
+
+    offset = await begin()
+    if offset:
+        print(f"resuming at {offset}")
+    start = time.monotonic()
+    while True:
+        seq = 0
+        while offset < len(image):
+            window = []
+            for _ in range(args.window):
+                chunk = image[offset:offset + payload]
+                if not chunk:
+                    break
+                frame = struct.pack("<BHI", DATA, seq & 0xFFFF,
+                                    zlib.crc32(chunk)) + chunk
+                await client.write_gatt_char(CHAR_FRAMED, frame,
+                                             response=False)
+                window.append(len(chunk))
+                seq += 1
+                offset += len(chunk)
+            if len(window) < args.window:
+                break  # partial last window is not acknowledged
+            while True:
+                try:
+                    code, next_seq, acked = await reply()
+                except asyncio.TimeoutError:
+                    offset = await begin()
+                    seq = 0
+                    break
+                if code in (CRC_ERROR, SEQ_ERROR):
+                    seq, offset = next_seq, acked  # resend from there
+                    break
+                if code != OK:
+                    raise Failed(STATUS.get(code, code))
+                if acked == offset:
+                    break  # older acks are skipped
+            progress(offset, len(image), start)
+        # make sure nothing in the last window was lost before ending
+        offset = await begin()
+        if offset == len(image):
+            break
+    await client.write_gatt_char(CHAR_FRAMED, bytes([END]), response=True)
+    code = VERIFYING
+    while code == VERIFYING:  # the result follows once the image is checked
+        code, _, _ = await asyncio.wait_for(replies.get(), 30)
+    if code != DONE:
+        raise Failed(f"end: {STATUS.get(code, code)}")
+
+
+async def upload(args, image):
+    start = time.monotonic()
+    for attempt in range(args.retries + 1):
+        try:
+            device = await find(args.name)
+            async with BleakClient(device) as client:
+                if args.protocol == "stream":
+                    await upload_stream(client, args, image)
+                else:
+                    await upload_framed(client, args, image)
+            break
+        except (BleakError, asyncio.TimeoutError, EOFError) as error:
+            if args.protocol == "stream" or attempt == args.retries:
+                raise Failed(f"connection lost: {error}")
+            print(f"\nconnection lost ({error}), reconnecting")
+            await asyncio.sleep(2)
+    elapsed = time.monotonic() - start
+    print(f"\r{len(image)} bytes in {elapsed:.1f} s "
+          f"({len(image) / elapsed / 1024:.1f} KiB/s)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", type=argparse.FileType("rb"))
+    parser.add_argument("--name", default="Watchy BLE OTA")
+    parser.add_argument("--protocol", choices=("framed", "stream"),
+                        default="framed")
+    parser.add_argument("--window", type=int, default=16)
+    parser.add_argument("--timeout", type=float, default=10.0,
+                        help="seconds to wait for each acknowledgement")
+    parser.add_argument("--retries", type=int, default=5,
+                        help="reconnect attempts for the framed protocol")
+    args = parser.parse_args()
+    try:
+        asyncio.run(upload(args, args.image.read()))
+    except Failed as error:
+        sys.exit(f"\nupload failed: {error}")
+
+
+if __name__ == "__main__":
+    main()
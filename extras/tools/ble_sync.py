@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Push time and weather to Watchy over BLE, standing in for a phone.
+
+    pip install bleak
+    python3 ble_sync.py --offline               # canned weather, once
+    python3 ble_sync.py --api-key KEY --city-id 2950159 --loop
+
+With settings.bleSync set, the watch advertises its sync service for a few
+seconds whenever the weather is due. This tool connects, reads the watch's
+request (units and a nonce), writes back the same binary record
+weather_proxy.py serves over UDP, stamped with this machine's clock, and
+disconnects. --loop keeps scanning for the next window.
+
+The record characteristic only takes writes over an encrypted link paired
+with settings.blePasskey. Pair and trust the watch once while it
+advertises (e.g. `bluetoothctl pair <address>`, entering the passkey);
+later syncs reuse the bond.
+"""
+
+import argparse
+import asyncio
+import struct
+import time
+
+from bleak import BleakClient, BleakScanner
+from bleak.exc import BleakError
+
+from weather_proxy import FLAG_METRIC, VERSION, Upstream, build_record
+
+SERVICE_SYNC = "86b12870-4b70-4893-8ce6-9864fc00374d"
+CHAR_REQUEST = "86b12871-4b70-4893-8ce6-9864fc00374d"
+CHAR_RECORD = "86b12872-4b70-4893-8ce6-9864fc00374d"
+
+
+async def sync_once(upstream, timeout):
+    device = await BleakScanner.find_device_by_filter(
+        lambda d, ad: SERVICE_SYNC in ad.service_uuids, timeout=timeout)
+    if device is None:
+        return False
+    start = time.monotonic()
+    async with BleakClient(device) as client:
+        request = await client.read_gatt_char(CHAR_REQUEST)
+        if len(request) < 8 or request[:2] != b"WQ" or request[2] != VERSION:
+            print(f"{device.address}: unexpected request {request.hex()}")
+            return False
+        nonce = struct.unpack(">I", request[4:8])[0]
+        weather = upstream.get()
+        record = build_record(weather, nonce, bool(request[3] & FLAG_METRIC))
+        await client.write_gatt_char(CHAR_RECORD, record, response=True)
+    print(f"{device.address}: synced in "
+          f"{(time.monotonic() - start) * 1000:.0f} ms, {len(record)} bytes")
+    return True
+
+
+async def run(args):
+    upstream = Upstream(args)
+    if upstream.get() is None:
+        raise SystemExit("no weather to send")
+    while True:
+        try:
+            synced = await sync_once(upstream, args.scan_timeout)
+        except (BleakError, asyncio.TimeoutError) as error:
+            print(f"sync failed: {error}")
+            synced = False
+        if not args.loop:
+            raise SystemExit(0 if synced else 1)
+        if synced:
+            await asyncio.sleep(10)  # the watch is back asleep
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--api-key")
+    parser.add_argument("--city-id")
+    parser.add_argument("--lat")
+    parser.add_argument("--lon")
+    parser.add_argument("--lang", default="en")
+    parser.add_argument("--refresh", type=int, default=600,
+                        help="seconds between upstream fetches")
+    parser.add_argument("--offline", action="store_true",
+                        help="send fixed values, no upstream access")
+    parser.add_argument("--loop", action="store_true")
+    parser.add_argument("--scan-timeout", type=float, default=60)
+    args = parser.parse_args()
+    if not args.offline and not (args.api_key and
+                                 (args.city_id or (args.lat and args.lon))):
+        parser.error("--api-key and --city-id or --lat/--lon are required")
+    asyncio.run(run(args))
+
+
+if __name__ == "__main__":
+    main()
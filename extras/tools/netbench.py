@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Local stand-in weather HTTP and NTP servers for benchmarking Watchy's
+network path (see examples/NetBench).
+
+The weather server answers OpenWeatherMap style requests on any path with a
+canned /data/2.5/weather response. The NTP server answers SNTP requests from
+the host clock. Both can inject latency, packet loss and errors, and log the
+bytes moved per request.
+
+    python3 netbench.py --http-port 8080 --ntp-port 1123 --latency 80 --loss 0.1
+
+Point the sketch at http://<host>:8080/data/2.5/weather?... and <host>:1123.
+"""
+
+import argparse
+import json
+import random
+import socket
+import struct
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+NTP_UNIX_OFFSET = 2208988800
+
+stats_lock = threading.Lock()
+stats = {"http": 0, "http_bytes_in": 0, "http_bytes_out": 0,
+         "ntp": 0, "ntp_dropped": 0, "ntp_bytes_in": 0, "ntp_bytes_out": 0}
+
+
+def count(**kw):
+    with stats_lock:
+        for key, value in kw.items():
+            stats[key] += value
+
+
+def weather_body(units):
+    now = int(time.time())
+    temp = 21.4 if units != "imperial" else 70.5
+    return json.dumps({
+        "coord": {"lon": 13.41, "lat": 52.52},
+        "weather": [{"id": 801, "main": "Clouds",
+                     "description": "few clouds", "icon": "02d"}],
+        "main": {"temp": temp, "feels_like": temp, "pressure": 1016,
+                 "humidity": 60},
+        "sys": {"country": "DE", "sunrise": now - 6 * 3600,
+                "sunset": now + 6 * 3600},
+        "timezone": 3600,
+        "id": 2950159,
+        "name": "Berlin",
+        "cod": 200,
+    }).encode()
+
+
+def make_http_handler(args):
+    class WeatherHandler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def do_GET(self):
+            request_bytes = len(self.requestline) + sum(
+                len(k) + len(v) + 4 for k, v in self.headers.items()) + 4
+            time.sleep(args.latency / 1000.0)
+            if random.random() < args.loss:
+                self.close_connection = True  # drop, client times out
+                count(http=1, http_bytes_in=request_bytes)
+                return
+            if random.random() < args.error_rate:
+                body = b'{"cod":500,"message":"injected error"}'
+                self.send_response(500)
+            elif random.random() < args.garbage_rate:
+                body = b'{"main":{"temp":'  # truncated JSON
+                self.send_response(200)
+            else:
+                units = "imperial" if "units=imperial" in self.path else "metric"
+                body = weather_body(units)
+                self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+            # status line and headers are roughly 100 bytes
+            count(http=1, http_bytes_in=request_bytes,
+                  http_bytes_out=len(body) + 100)
+            if args.verbose:
+                print(f"http {self.client_address[0]} {self.path} "
+                      f"in={request_bytes} out={len(body)}")
+
+        def log_message(self, fmt, *a):
+            pass
+
+    return WeatherHandler
+
+
+def ntp_timestamp(t):
+    seconds = int(t) + NTP_UNIX_OFFSET
+    fraction = int((t - int(t)) * (1 << 32))
+    return struct.pack("!II", seconds & 0xFFFFFFFF, fraction)
+
+
+def serve_ntp(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", args.ntp_port))
+    while True:
+        data, addr = sock.recvfrom(512)
+        received = time.time()
+        count(ntp=1, ntp_bytes_in=len(data))
+        if len(data) < 48 or random.random() < args.loss:
+            count(ntp_dropped=1)
+            continue
+        time.sleep(args.latency / 1000.0)
+        if random.random() < args.error_rate:
+            # kiss-o'-death RATE, stratum 0
+            reply = bytes([0xE4, 0, 6, 0xEC]) + bytes(8) + b"RATE"
+            reply += bytes(8) + data[40:48] + bytes(16)
+        else:
+            reply = bytes([0x24, 2, 6, 0xEC]) + bytes(8) + b"LOCL"
+            reply += ntp_timestamp(received)  # reference
+            reply += data[40:48]  # originate = client transmit
+            reply += ntp_timestamp(received)
+            reply += ntp_timestamp(time.time())
+        sock.sendto(reply, addr)
+        count(ntp_bytes_out=len(reply))
+        if args.verbose:
+            print(f"ntp {addr[0]}:{addr[1]} in={len(data)} out={len(reply)}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--http-port", type=int, default=8080)
+    parser.add_argument("--ntp-port", type=int, default=1123)
+    parser.add_argument("--latency", type=float, default=0,
+                        help="added response latency in ms")
+    parser.add_argument("--loss", type=float, default=0,
+                        help="probability of dropping a request")
+    parser.add_argument("--error-rate", type=float, default=0,
+                        help="probability of HTTP 500 / NTP kiss-o'-death")
+    parser.add_argument("--garbage-rate", type=float, default=0,
+                        help="probability of a truncated weather response")
+    parser.add_argument("--report", type=float, default=10,
+                        help="seconds between stats reports, 0 disables")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    httpd = ThreadingHTTPServer(("0.0.0.0", args.http_port),
+                                make_http_handler(args))
+    threading.Thread(target=httpd.serve_forever, daemon=True).start()
+    threading.Thread(target=serve_ntp, args=(args,), daemon=True).start()
+    print(f"weather on :{args.http_port}, ntp on :{args.ntp_port}")
+    try:
+        while True:
+            time.sleep(args.report or 3600)
+            if args.report:
+                with stats_lock:
+                    print(" ".join(f"{k}={v}" for k, v in stats.items()))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
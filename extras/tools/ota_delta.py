@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Make a delta OTA image against the firmware running on the watch.
+
+    python3 ota_delta.py old/Watchy.ino.bin new/Watchy.ino.bin face.wotd
+    python3 ota_delta.py --pack old.bin new.bin face.wotz
+
+The watch rebuilds the new image from COPY ranges of its running partition
+and INSERTed literal bytes (format in src/OTAUpdate.h), after checking the
+CRC-32 of the old image it was made against, so a delta only installs over
+exactly that firmware. --pack deflates the delta as well (see ota_pack.py),
+which is what makes unchanged-but-shifted code cheap to send.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+from ota_pack import pack
+
+MAGIC = b"WOTD"
+VERSION = 1
+COPY, INSERT = 1, 2
+KEY = 16      # bytes hashed to find a candidate match
+STRIDE = 4    # old image positions indexed
+MIN_COPY = 24  # shorter matches cost more than they save
+
+
+def index(old):
+    table = {}
+    for offset in range(0, len(old) - KEY + 1, STRIDE):
+        table.setdefault(old[offset:offset + KEY], []).append(offset)
+    return table
+
+
+def diff(old, new):
+    """Returns a list of (COPY, offset, length) and (INSERT, bytes) ops."""
+    table = index(old)
+    ops, literal = [], bytearray()
+    position, follow = 0, 0
+    while position < len(new):
+        best_offset, best_length = 0, 0
+        # the indexed old offsets are STRIDE apart, so try aligning any of
+        # the next STRIDE new positions with them; the spot right after the
+        # previous copy is always tried first
+        for lead in range(STRIDE):
+            start = position + lead
+            candidates = table.get(new[start:start + KEY], [])[:8]
+            if lead == 0 and new[start:start + KEY] == old[follow:follow + KEY]:
+                candidates = [follow] + candidates
+            for candidate in candidates:
+                length = KEY
+                while (start + length < len(new) and
+                       candidate + length < len(old) and
+                       new[start + length] == old[candidate + length]):
+                    length += 1
+                # extend backwards over the lead bytes
+                back = 0
+                while (back < lead and candidate - back > 0 and
+                       new[start - back - 1] == old[candidate - back - 1]):
+                    back += 1
+                if length + back > best_length and back == lead:
+                    best_offset, best_length = candidate - back, length + back
+            if best_length:
+                break
+        if best_length >= MIN_COPY:
+            if literal:
+                ops.append((INSERT, bytes(literal)))
+                literal = bytearray()
+            ops.append((COPY, best_offset, best_length))
+            position += best_length
+            follow = best_offset + best_length
+        else:
+            literal.append(new[position])
+            position += 1
+    if literal:
+        ops.append((INSERT, bytes(literal)))
+    return ops
+
+
+def encode(old, new, ops):
+    out = bytearray(MAGIC + struct.pack("<B3xIII", VERSION, len(new),
+                                        len(old), zlib.crc32(old)))
+    for op in ops:
+        if op[0] == COPY:
+            out += struct.pack("<BII", COPY, op[1], op[2])
+        else:
+            out += struct.pack("<BI", INSERT, len(op[1])) + op[1]
+    return bytes(out)
+
+
+def apply(old, delta):
+    """Reference decoder, used to check every delta before it is written."""
+    if delta[:4] != MAGIC:
+        raise ValueError("not a delta")
+    version, size, old_size, crc = struct.unpack("<B3xIII", delta[4:20])
+    if version != VERSION or zlib.crc32(old[:old_size]) != crc:
+        raise ValueError("delta does not match the old image")
+    out, position = bytearray(), 20
+    while position < len(delta):
+        if delta[position] == COPY:
+            offset, length = struct.unpack("<II", delta[position + 1:
+                                                        position + 9])
+            out += old[offset:offset + length]
+            position += 9
+        else:
+            length = struct.unpack("<I", delta[position + 1:position + 5])[0]
+            out += delta[position + 5:position + 5 + length]
+            position += 5 + length
+    if len(out) != size:
+        raise ValueError("size mismatch")
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("old", type=argparse.FileType("rb"),
+                        help="image currently running on the watch")
+    parser.add_argument("new", type=argparse.FileType("rb"))
+    parser.add_argument("output", type=argparse.FileType("wb"))
+    parser.add_argument("--pack", action="store_true",
+                        help="deflate the delta for transfer")
+    parser.add_argument("--window-bits", type=int, default=12)
+    args = parser.parse_args()
+    old, new = args.old.read(), args.new.read()
+    ops = diff(old, new)
+    delta = encode(old, new, ops)
+    if apply(old, delta) != new:
+        sys.exit("round trip failed")
+    copied = sum(op[2] for op in ops if op[0] == COPY)
+    output = pack(delta, args.window_bits) if args.pack else delta
+    args.output.write(output)
+    print(f"{len(new)} byte image, {100 * copied / max(len(new), 1):.1f}% "
+          f"copied from the old one, {len(output)} bytes to send")
+
+
+if __name__ == "__main__":
+    main()
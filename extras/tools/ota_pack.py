@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Pack a firmware image for compressed BLE OTA (see src/OTAUpdate.h).
+
+    python3 ota_pack.py build/Watchy.ino.bin Watchy.wotz
+
+The output is a 12 byte header followed by a raw deflate stream whose window
+is at most 2^--window-bits bytes; the watch inflates it with the same window
+while writing flash. --window-bits must not exceed OTA_INFLATE_WINDOW_BITS.
+Upload the result like a plain image, e.g. with ble_ota.py.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"WOTZ"
+VERSION = 1
+
+
+def pack(image, window_bits):
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -window_bits, 9)
+    stream = compressor.compress(image) + compressor.flush()
+    header = MAGIC + struct.pack("<BBHI", VERSION, window_bits, 0, len(image))
+    return header + stream
+
+
+def unpack(packed):
+    magic, (version, window_bits, _, size) = packed[:4], \
+        struct.unpack("<BBHI", packed[4:12])
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a packed image")
+    image = zlib.decompress(packed[12:], -window_bits)
+    if len(image) != size:
+        raise ValueError("size mismatch")
+    return image
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", type=argparse.FileType("rb"))
+    parser.add_argument("output", type=argparse.FileType("wb"))
+    parser.add_argument("--window-bits", type=int, default=12,
+                        choices=range(9, 16), metavar="9..15")
+    args = parser.parse_args()
+    image = args.image.read()
+    if image[:1] != b"\xe9":
+        print("warning: input does not look like an ESP32 app image",
+              file=sys.stderr)
+    packed = pack(image, args.window_bits)
+    if unpack(packed) != image:
+        sys.exit("round trip failed")
+    args.output.write(packed)
+    print(f"{len(image)} -> {len(packed)} bytes "
+          f"({100 * len(packed) / len(image):.1f}%), "
+          f"{1 << args.window_bits} byte window")
+
+
+if __name__ == "__main__":
+    main()
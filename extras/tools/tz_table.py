@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Compile a POSIX TZ rule into a transition table for src/TimeZone.h.
+
+    python3 tz_table.py "CET-1CEST,M3.5.0,M10.5.0/3" > timezone.h
+    python3 tz_table.py "EST5EDT,M3.2.0,M11.1.0" --from 2025 --to 2060
+
+The rule of a tz database zone is the last line of its compiled file, e.g.
+`tail -n 1 /usr/share/zoneinfo/Europe/Berlin`. Put the header next to the
+sketch and hand the table to the watch:
+
+    #include "timezone.h"
+    watchySettings settings{
+        ...
+        .tzTable = TZ_TABLE,
+        .tzTableSize = TZ_TABLE_SIZE,
+    };
+
+Each transition takes 8 bytes of flash, two per year for zones with DST.
+"""
+
+import argparse
+import calendar
+import datetime
+import re
+import sys
+
+NAME = r"(?:<[^>]+>|[A-Za-z]{3,})"
+OFFSET = r"[+-]?\d{1,3}(?::\d{1,2}){0,2}"
+RULE = r"(?:M\d{1,2}\.\d\.\d|J\d{1,3}|\d{1,3})(?:/" + OFFSET + ")?"
+TZ = re.compile(r"^(%s)(%s)(?:(%s)(%s)?(?:,(%s),(%s))?)?$" %
+                (NAME, OFFSET, NAME, OFFSET, RULE, RULE))
+
+
+def seconds(text):
+    """[+-]hh[:mm[:ss]] to seconds."""
+    sign = -1 if text.startswith("-") else 1
+    parts = [int(p) for p in text.lstrip("+-").split(":")]
+    parts += [0] * (3 - len(parts))
+    return sign * (parts[0] * 3600 + parts[1] * 60 + parts[2])
+
+
+def rule_day(rule, year):
+    """Midnight of the rule's date in year as a day number since 1970."""
+    epoch = datetime.date(1970, 1, 1)
+    if rule.startswith("M"):
+        month, week, weekday = (int(p) for p in rule[1:].split("."))
+        first = datetime.date(year, month, 1)
+        # weekday 0 is Sunday in POSIX, 6 in Python
+        day = 1 + (weekday - (first.weekday() + 1) % 7) % 7 + 7 * (week - 1)
+        last = calendar.monthrange(year, month)[1]
+        while day > last:  # week 5 means the last one
+            day -= 7
+        return (datetime.date(year, month, day) - epoch).days
+    if rule.startswith("J"):  # 1-365, February 29 never counted
+        day = int(rule[1:])
+        if calendar.isleap(year) and day >= 60:
+            day += 1
+        return (datetime.date(year, 1, 1) - epoch).days + day - 1
+    return (datetime.date(year, 1, 1) - epoch).days + int(rule)  # 0-365
+
+
+def transitions(tz, first_year, last_year):
+    match = TZ.match(tz)
+    if match is None:
+        raise ValueError("not a POSIX TZ rule: %s" % tz)
+    std_name, std, dst_name, dst, start, end = match.groups()
+    std_offset = -seconds(std)  # POSIX counts west of UTC
+    if dst_name is None:
+        return [(0, std_offset)]
+    if start is None:
+        raise ValueError("DST without rules, add ,start,end to %s" % tz)
+    dst_offset = -seconds(dst) if dst else std_offset + 3600
+
+    def at(rule, year, offset):
+        date, _, time = rule.partition("/")
+        local = rule_day(date, year) * 86400 + (seconds(time) if time
+                                                else 7200)
+        return local - offset
+
+    changes = []
+    for year in range(first_year, last_year + 1):
+        # start is given in standard time, end in daylight time
+        changes.append((at(start, year, std_offset), dst_offset))
+        changes.append((at(end, year, dst_offset), std_offset))
+    changes.sort()
+    # Southern zones begin the year in daylight time
+    before = std_offset if changes[0][1] == dst_offset else dst_offset
+    return [(0, before)] + changes
+
+
+def main():
+    this_year = datetime.date.today().year
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("tz", help="POSIX TZ rule")
+    parser.add_argument("--from", dest="first", type=int, default=this_year)
+    parser.add_argument("--to", dest="last", type=int, default=this_year + 30)
+    parser.add_argument("--name", default="TZ_TABLE")
+    args = parser.parse_args()
+    if args.last > 2105:
+        parser.error("--to past 2105 does not fit the 32 bit table")
+    try:
+        table = transitions(args.tz, args.first, args.last)
+    except ValueError as error:
+        parser.error(str(error))
+
+    out = sys.stdout
+    out.write("// Generated by extras/tools/tz_table.py \"%s\" --from %d "
+              "--to %d\n" % (args.tz, args.first, args.last))
+    out.write("#pragma once\n#include <TimeZone.h>\n\n")
+    out.write("static const tzTransition %s[] = {\n" % args.name)
+    for utc, offset in table:
+        stamp = datetime.datetime.fromtimestamp(utc, datetime.timezone.utc)
+        out.write("    {%10d, %5d}, // %s UTC\n" %
+                  (utc, offset // 60, stamp.strftime("%Y-%m-%d %H:%M")))
+    out.write("};\n#define %s_SIZE (sizeof(%s) / sizeof(%s[0]))\n" %
+              (args.name, args.name, args.name))
+
+
+if __name__ == "__main__":
+    main()
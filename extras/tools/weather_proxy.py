@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Reference proxy for Watchy's compact weather record (src/WeatherRecord.h).
+
+Fetches OpenWeatherMap once per --refresh seconds, converts the response to
+the binary record and answers each 8 byte UDP request with a single datagram
+of at most 47 bytes, stamped with the proxy's clock so the watch can skip NTP.
+
+    python3 weather_proxy.py --api-key KEY --city-id 2950159 --port 4210
+
+and set the face's weatherURL to "wxr://<proxy host>:4210". --offline serves
+fixed values without an API key.
+"""
+
+import argparse
+import binascii
+import json
+import socket
+import struct
+import threading
+import time
+import urllib.parse
+import urllib.request
+
+VERSION = 1
+FLAG_METRIC = 0x01
+FLAG_TIME = 0x02
+OWM_URL = "https://api.openweathermap.org/data/2.5/weather"
+
+
+def crc16(data):
+    return binascii.crc_hqx(data, 0xFFFF)
+
+
+def build_record(weather, nonce, metric):
+    now = time.time()
+    description = weather["description"].encode("ascii", "replace")[:15]
+    flags = FLAG_TIME | (FLAG_METRIC if metric else 0)
+    temp = weather["temp_c"] if metric else weather["temp_c"] * 9 / 5 + 32
+    body = struct.pack(">2sBBIbBhiiiIH", b"WX", VERSION, flags, nonce,
+                       max(-128, min(127, round(temp))), len(description),
+                       weather["id"], weather["sunrise"], weather["sunset"],
+                       weather["timezone"], int(now),
+                       int((now - int(now)) * 1000))
+    body += description
+    return body + struct.pack(">H", crc16(body))
+
+
+class Upstream:
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.weather = None
+        self.fetched = 0
+
+    def get(self):
+        with self.lock:
+            if self.weather is None or \
+                    time.time() - self.fetched > self.args.refresh:
+                try:
+                    self.weather = self.fetch()
+                    self.fetched = time.time()
+                except Exception as error:  # keep serving the last values
+                    print(f"upstream fetch failed: {error}")
+            return self.weather
+
+    def fetch(self):
+        if self.args.offline:
+            now = int(time.time())
+            return {"temp_c": 18.0, "id": 800, "description": "Clear",
+                    "sunrise": now - 3600, "sunset": now + 3600,
+                    "timezone": 0}
+        query = {"appid": self.args.api_key, "units": "metric",
+                 "lang": self.args.lang}
+        if self.args.city_id:
+            query["id"] = self.args.city_id
+        else:
+            query["lat"], query["lon"] = self.args.lat, self.args.lon
+        url = OWM_URL + "?" + urllib.parse.urlencode(query)
+        with urllib.request.urlopen(url, timeout=10) as response:
+            data = json.load(response)
+        return {"temp_c": float(data["main"]["temp"]),
+                "id": int(data["weather"][0]["id"]),
+                "description": data["weather"][0]["main"],
+                "sunrise": int(data["sys"]["sunrise"]),
+                "sunset": int(data["sys"]["sunset"]),
+                "timezone": int(data["timezone"])}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=4210)
+    parser.add_argument("--api-key")
+    parser.add_argument("--city-id")
+    parser.add_argument("--lat")
+    parser.add_argument("--lon")
+    parser.add_argument("--lang", default="en")
+    parser.add_argument("--refresh", type=int, default=600,
+                        help="seconds between upstream fetches")
+    parser.add_argument("--offline", action="store_true",
+                        help="serve fixed values, no upstream access")
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+    if not args.offline and not (args.api_key and
+                                 (args.city_id or (args.lat and args.lon))):
+        parser.error("--api-key and --city-id or --lat/--lon are required")
+
+    upstream = Upstream(args)
+    upstream.get()  # warm up before the first request
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", args.port))
+    print(f"weather proxy on udp :{args.port}")
+    while True:
+        data, addr = sock.recvfrom(64)
+        if len(data) < 8 or data[:2] != b"WQ" or data[2] != VERSION:
+            continue
+        weather = upstream.get()
+        if weather is None:
+            continue  # nothing to serve yet, the watch falls back
+        nonce = struct.unpack(">I", data[4:8])[0]
+        record = build_record(weather, nonce, bool(data[3] & FLAG_METRIC))
+        sock.sendto(record, addr)
+        if args.verbose:
+            print(f"{addr[0]}:{addr[1]} {len(data)}B -> {len(record)}B")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,139 @@
+#include "Actigraphy.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#else
+#define RTC_DATA_ATTR // host builds, extras/tools/actigraphy_replay.cpp
+#endif
+
+typedef struct actigraphyState {
+  bool active;
+  bool primed; // last holds a sample
+  uint32_t start;
+  uint16_t epochs;
+  uint16_t samples; // in the current epoch
+  uint32_t count;   // activity of the current epoch
+  int16_t last[3];
+  uint8_t epoch[ACTIGRAPHY_MAX_EPOCHS];
+} actigraphyState;
+
+RTC_DATA_ATTR actigraphyState actigraphy;
+
+static const uint16_t sleepWeights[7] = {106, 54, 58, 76, 230, 74, 67};
+
+static uint16_t isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit  = 1UL << 30;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+static uint16_t absDiff(int16_t a, int16_t b) {
+  return a > b ? a - b : b - a;
+}
+
+void Actigraphy::begin(uint32_t now) {
+  memset(&actigraphy, 0, sizeof(actigraphy));
+  actigraphy.active = true;
+  actigraphy.start  = now;
+}
+
+void Actigraphy::addSample(int16_t x, int16_t y, int16_t z) {
+  if (!actigraphy.active) {
+    return;
+  }
+  if (actigraphy.primed) {
+    uint16_t dx     = absDiff(x, actigraphy.last[0]);
+    uint16_t dy     = absDiff(y, actigraphy.last[1]);
+    uint16_t dz     = absDiff(z, actigraphy.last[2]);
+    uint16_t change = dx + dy + dz;
+    if (change > ACTIGRAPHY_DEADBAND) {
+      actigraphy.count += change - ACTIGRAPHY_DEADBAND;
+    }
+  }
+  actigraphy.last[0] = x;
+  actigraphy.last[1] = y;
+  actigraphy.last[2] = z;
+  actigraphy.primed  = true;
+  if (++actigraphy.samples >= ACTIGRAPHY_EPOCH_SAMPLES) {
+    _closeEpoch();
+  }
+}
+
+void Actigraphy::_closeEpoch() {
+  if (actigraphy.epochs < ACTIGRAPHY_MAX_EPOCHS) {
+    uint16_t value = isqrt(actigraphy.count);
+    actigraphy.epoch[actigraphy.epochs++] = value > 255 ? 255 : value;
+  }
+  actigraphy.samples = 0;
+  actigraphy.count   = 0;
+}
+
+// A partial epoch at the end is dropped
+void Actigraphy::end() { actigraphy.active = false; }
+
+bool Actigraphy::active() { return actigraphy.active; }
+
+uint16_t Actigraphy::epochs() { return actigraphy.epochs; }
+
+uint8_t Actigraphy::epoch(uint16_t index) {
+  return index < actigraphy.epochs ? actigraphy.epoch[index] : 0;
+}
+
+bool Actigraphy::asleep(uint16_t index) {
+  uint32_t score = 0;
+  for (int i = 0; i < 7; i++) {
+    int32_t at = (int32_t)index + i - 4;
+    if (at >= 0 && at < actigraphy.epochs) {
+      score += (uint32_t)sleepWeights[i] * actigraphy.epoch[at];
+    }
+  }
+  return score < ACTIGRAPHY_SLEEP_THRESHOLD;
+}
+
+// Sleep starts with the first ACTIGRAPHY_ONSET_EPOCHS sleep epochs in a row
+// and ends after the last sleep epoch; false until a night was recorded.
+bool Actigraphy::summarize(sleepSummary &out) {
+  memset(&out, 0, sizeof(out));
+  out.start  = actigraphy.start;
+  out.epochs = actigraphy.epochs;
+  uint16_t run = 0;
+  bool found   = false;
+  for (uint16_t i = 0; i < actigraphy.epochs && !found; i++) {
+    run = asleep(i) ? run + 1 : 0;
+    if (run == ACTIGRAPHY_ONSET_EPOCHS) {
+      out.onset = i + 1 - run;
+      found     = true;
+    }
+  }
+  if (!found) {
+    return false;
+  }
+  out.wake = actigraphy.epochs;
+  while (out.wake > out.onset && !asleep(out.wake - 1)) {
+    out.wake--;
+  }
+  bool awake = false;
+  for (uint16_t i = out.onset; i < out.wake; i++) {
+    if (asleep(i)) {
+      out.asleep++;
+      awake = false;
+    } else if (!awake) {
+      out.awakenings += out.awakenings < 255;
+      awake = true;
+    }
+  }
+  out.efficiency = (uint32_t)out.asleep * 100 / (out.wake - out.onset);
+  return true;
+}
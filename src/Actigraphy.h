@@ -0,0 +1,41 @@
+#ifndef ACTIGRAPHY_H
+#define ACTIGRAPHY_H
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+
+typedef struct sleepSummary {
+  uint32_t start;      // RTC time tracking began
+  uint16_t epochs;     // epochs recorded
+  uint16_t onset;      // first epoch of the first sustained sleep
+  uint16_t wake;       // epoch after the last sleep epoch
+  uint16_t asleep;     // sleep epochs between onset and wake
+  uint8_t awakenings;  // wake runs between onset and wake
+  uint8_t efficiency;  // asleep in % of onset..wake
+} sleepSummary;
+
+// Overnight activity tracking from low rate accelerometer samples, integer
+// math only and no Arduino dependencies so extras/tools/actigraphy_replay.cpp
+// can run it on recorded traces.
+//
+// Each sample adds the summed absolute change of the three axes beyond a
+// noise dead band; every ACTIGRAPHY_EPOCH_SAMPLES samples the total is
+// stored as one byte, isqrt(count) clamped to 255. Epochs are scored with
+// the Cole-Kripke weights (A-4 .. A+2) against ACTIGRAPHY_SLEEP_THRESHOLD.
+class Actigraphy {
+public:
+  static void begin(uint32_t now);
+  static void addSample(int16_t x, int16_t y, int16_t z);
+  static void end();
+  static bool active();
+  static uint16_t epochs();
+  static uint8_t epoch(uint16_t index);
+  static bool asleep(uint16_t index);
+  static bool summarize(sleepSummary &out);
+
+private:
+  static void _closeEpoch();
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "Alarms.h"
+
+#if ALARM_SLOTS > 8
+#error "ALARM_SLOTS does not fit the bit mask of Alarms::due()"
+#endif
+
+typedef struct alarmTable {
+  time_t checked; // due() rang everything up to here, 0 before the first call
+  userAlarm slot[ALARM_SLOTS];
+} alarmTable;
+
+RTC_DATA_ATTR alarmTable userAlarms;
+
+bool Alarms::setClock(uint8_t slot, uint8_t hour, uint8_t minute,
+                      uint8_t days) {
+  if (slot >= ALARM_SLOTS || hour > 23 || minute > 59 || days > 0x7F) {
+    return false;
+  }
+  userAlarm &alarm = userAlarms.slot[slot];
+  alarm.type       = ALARM_CLOCK;
+  alarm.hour       = hour;
+  alarm.minute     = minute;
+  alarm.days       = days;
+  alarm.deadline   = 0;
+  return true;
+}
+
+bool Alarms::startTimer(uint8_t slot, uint32_t seconds, time_t now) {
+  if (slot >= ALARM_SLOTS || seconds == 0) {
+    return false;
+  }
+  userAlarm &alarm = userAlarms.slot[slot];
+  alarm.type       = ALARM_TIMER;
+  alarm.hour       = 0;
+  alarm.minute     = 0;
+  alarm.days       = 0;
+  alarm.deadline   = now + seconds;
+  if (userAlarms.checked == 0) {
+    userAlarms.checked = now;
+  }
+  return true;
+}
+
+void Alarms::cancel(uint8_t slot) {
+  if (slot < ALARM_SLOTS) {
+    userAlarms.slot[slot].type = ALARM_OFF;
+  }
+}
+
+bool Alarms::get(uint8_t slot, userAlarm &out) {
+  if (slot >= ALARM_SLOTS || userAlarms.slot[slot].type == ALARM_OFF) {
+    return false;
+  }
+  out = userAlarms.slot[slot];
+  return true;
+}
+
+bool Alarms::timing() {
+  for (uint8_t i = 0; i < ALARM_SLOTS; i++) {
+    if (userAlarms.slot[i].type == ALARM_TIMER) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// First hour:minute strictly after the given time on one of the alarm's days
+time_t Alarms::_nextClock(const userAlarm &alarm, time_t after) {
+  time_t day = previousMidnight(after);
+  for (uint8_t i = 0; i < 8; i++) {
+    time_t at = day + i * SECS_PER_DAY + alarm.hour * SECS_PER_HOUR +
+                alarm.minute * SECS_PER_MIN;
+    if (at > after &&
+        (alarm.days == 0 || alarm.days & (1 << (dayOfWeek(at) - 1)))) {
+      return at;
+    }
+  }
+  return 0;
+}
+
+time_t Alarms::next(time_t now) {
+  time_t after = userAlarms.checked;
+  if (after == 0 || after > now) {
+    after = now; // what due() will start from
+  }
+  time_t nearest = 0;
+  for (uint8_t i = 0; i < ALARM_SLOTS; i++) {
+    const userAlarm &alarm = userAlarms.slot[i];
+    time_t at              = 0;
+    if (alarm.type == ALARM_CLOCK) {
+      at = _nextClock(alarm, after);
+    } else if (alarm.type == ALARM_TIMER) {
+      at = alarm.deadline;
+    }
+    if (at != 0 && (nearest == 0 || at < nearest)) {
+      nearest = at;
+    }
+  }
+  return nearest;
+}
+
+uint8_t Alarms::due(time_t now) {
+  if (userAlarms.checked == 0 || now < userAlarms.checked) {
+    userAlarms.checked = now; // first call, or the RTC was set backwards
+  }
+  uint8_t rung = 0;
+  for (uint8_t i = 0; i < ALARM_SLOTS; i++) {
+    userAlarm &alarm = userAlarms.slot[i];
+    bool ring        = false;
+    if (alarm.type == ALARM_CLOCK) {
+      time_t at = _nextClock(alarm, userAlarms.checked);
+      ring      = at != 0 && at <= now;
+      if (ring && alarm.days == 0) {
+        alarm.type = ALARM_OFF;
+      }
+    } else if (alarm.type == ALARM_TIMER && alarm.deadline <= now) {
+      ring       = true;
+      alarm.type = ALARM_OFF;
+    }
+    if (ring) {
+      rung |= 1 << i;
+    }
+  }
+  userAlarms.checked = now;
+  return rung;
+}
+
+void Alarms::shift(long seconds) {
+  for (uint8_t i = 0; i < ALARM_SLOTS; i++) {
+    if (userAlarms.slot[i].type == ALARM_TIMER) {
+      userAlarms.slot[i].deadline += seconds;
+    }
+  }
+}
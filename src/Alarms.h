@@ -0,0 +1,44 @@
+#ifndef ALARMS_H
+#define ALARMS_H
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include "config.h"
+
+#define ALARM_OFF   0
+#define ALARM_CLOCK 1 // at hour:minute on the days in the mask
+#define ALARM_TIMER 2 // once at deadline
+
+typedef struct userAlarm {
+  uint8_t type;
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t days;    // bit 0 Sunday .. bit 6 Saturday, 0 rings once
+  time_t deadline; // timers, in RTC (local) time
+} userAlarm;
+
+// User alarms and countdown timers in ALARM_SLOTS slots of RTC memory.
+// Nothing polls them: due() runs on the RTC wakes the watch takes anyway and
+// rings every alarm whose time fell since the last call, so a missed tick
+// only rings late. Clock alarms fall on the minute tick; next() hands the
+// deadline of a timer to Watchy::deepSleep() for the one wake it needs.
+class Alarms {
+public:
+  static bool setClock(uint8_t slot, uint8_t hour, uint8_t minute,
+                       uint8_t days = 0);
+  static bool startTimer(uint8_t slot, uint32_t seconds, time_t now);
+  static void cancel(uint8_t slot);
+  static bool get(uint8_t slot, userAlarm &out); // false for an empty slot
+  static bool timing();                          // a timer runs
+  // Nearest deadline still to ring, at or before now when overdue; 0 for none
+  static time_t next(time_t now);
+  // Slots that came due up to now as a bit mask; one-shot slots turn off
+  static uint8_t due(time_t now);
+  // The RTC was moved by seconds, timers keep their remaining time
+  static void shift(long seconds);
+
+private:
+  static time_t _nextClock(const userAlarm &alarm, time_t after);
+};
+
+#endif
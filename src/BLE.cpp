@@ -8,6 +8,8 @@
 #define CHARACTERISTIC_UUID_HW_VERSION "86b12867-4b70-4893-8ce6-9864fc00374d"
 #define CHARACTERISTIC_UUID_WATCHFACE_NAME                                     \
   "86b12868-4b70-4893-8ce6-9864fc00374d"
+#define CHARACTERISTIC_UUID_FW_STREAM "86b12869-4b70-4893-8ce6-9864fc00374d"
+#define CHARACTERISTIC_UUID_FW_FRAMED "86b1286a-4b70-4893-8ce6-9864fc00374d"
 
 #define FULL_PACKET         512
 #define CHARPOS_UPDATE_FLAG 5
@@ -16,19 +18,99 @@
 #define STATUS_DISCONNECTED 4
 #define STATUS_UPDATING     1
 #define STATUS_READY        2
+#define STATUS_ERROR        3
+#define STATUS_PAUSED       5
 
-esp_ota_handle_t otaHandler = 0;
+// Framed transfer on CHARACTERISTIC_UUID_FW_FRAMED, all little endian:
+//  BEGIN  01 size (u32) sha256 (32)   resumes a matching interrupted image
+//  DATA   02 seq (u16) crc32 (u32) payload
+//  END    03                          answered with VERIFYING, then again
+//                                     once the image is verified
+//  ABORT  04
+// The watch notifies status (u8) next seq (u16) offset (u32) after BEGIN,
+// every BLE_ACK_WINDOW data frames, on any error and after END. After an
+// error it drops frames until the client resends from the notified seq and
+// offset.
+#define FRAME_BEGIN       0x01
+#define FRAME_DATA        0x02
+#define FRAME_END         0x03
+#define FRAME_ABORT       0x04
+#define FRAME_BEGIN_SIZE  37
+#define FRAME_DATA_HEADER 7
+
+#define FRAME_OK            0
+#define FRAME_CRC_ERROR     1
+#define FRAME_SEQ_ERROR     2
+#define FRAME_SIZE_ERROR    3
+#define FRAME_VERIFY_FAILED 4
+#define FRAME_FLASH_ERROR   5
+#define FRAME_NOT_STARTED   6
+#define FRAME_DONE          7
+#define FRAME_BASE_MISMATCH 8
+#define FRAME_VERIFYING     9 // END taken, the result follows
+
+OTAUpdate otaUpdate;
+
+int status           = -1;
+bool updateFlag      = false;
+size_t streamPacket  = 0; // packet size of the stream, set by the first write
+uint16_t streamCount = 0;
+uint16_t frameSeq    = 0;
+uint16_t frameCount  = 0;
+bool frameRejected   = false;
+
+static BLECharacteristic *framedCharacteristic = NULL;
+static volatile bool frameEnding               = false;
+static esp_timer_handle_t legacyEndTimer       = NULL;
 
-int status        = -1;
-int bytesReceived = 0;
-bool updateFlag   = false;
 
 class BLECustomServerCallbacks : public BLEServerCallbacks {
-  void onConnect(BLEServer *pServer) { status = STATUS_CONNECTED; };
+  void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) {
+    status = STATUS_CONNECTED;
+    // short connection interval while the link is up, the transfer is
+    // over sooner and the radio sleeps for good afterwards
+    pServer->updateConnParams(param->connect.remote_bda, BLE_CONN_INTERVAL_MIN,
+                              BLE_CONN_INTERVAL_MAX, 0, 400);
+  };
 
-  void onDisconnect(BLEServer *pServer) { status = STATUS_DISCONNECTED; }
+  void onDisconnect(BLEServer *pServer) {
+    if (otaUpdate.state() == OTA_RUNNING && otaUpdate.verifying()) {
+      // keep the framed transfer, the client can reconnect and resume
+      pServer->startAdvertising();
+      status = STATUS_PAUSED;
+      return;
+    }
+    if (otaUpdate.state() == OTA_RUNNING) {
+      otaUpdate.abort();
+      updateFlag = false;
+    }
+    status = STATUS_DISCONNECTED;
+  }
 };
 
+static bool _otaBegin() {
+  if (!updateFlag) { // If it's the first packet of OTA since bootup, begin OTA
+    if (!otaUpdate.begin()) {
+      status = STATUS_ERROR;
+      return false;
+    }
+    updateFlag   = true;
+    streamPacket = 0;
+    streamCount  = 0;
+    status       = STATUS_UPDATING;
+  }
+  return true;
+}
+
+// acknowledges the bytes accepted so far, little endian
+static void _otaAck(BLECharacteristic *pCharacteristic) {
+  uint32_t received = otaUpdate.received();
+  uint8_t txData[4] = {(uint8_t)received, (uint8_t)(received >> 8),
+                       (uint8_t)(received >> 16), (uint8_t)(received >> 24)};
+  pCharacteristic->setValue(txData, 4);
+  pCharacteristic->notify();
+}
+
 class otaCallback : public BLECharacteristicCallbacks {
 public:
   otaCallback(BLE *ble) { _p_ble = ble; }
@@ -37,29 +119,83 @@ public:
   void onWrite(BLECharacteristic *pCharacteristic);
 };
 
+class otaStreamCallback : public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic *pCharacteristic);
+};
+
+class otaFramedCallback : public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic *pCharacteristic);
+};
+
+static uint32_t _le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void _frameStatus(BLECharacteristic *pCharacteristic, uint8_t code) {
+  uint32_t offset   = otaUpdate.received();
+  uint8_t txData[7] = {code,
+                       (uint8_t)frameSeq,
+                       (uint8_t)(frameSeq >> 8),
+                       (uint8_t)offset,
+                       (uint8_t)(offset >> 8),
+                       (uint8_t)(offset >> 16),
+                       (uint8_t)(offset >> 24)};
+  pCharacteristic->setValue(txData, 7);
+  pCharacteristic->notify();
+}
+
+static uint8_t _frameError() {
+  switch (otaUpdate.error()) {
+  case OTA_ERR_SIZE:
+    return FRAME_SIZE_ERROR;
+  case OTA_ERR_VERIFY:
+  case OTA_ERR_FORMAT:
+    return FRAME_VERIFY_FAILED;
+  case OTA_ERR_BASE:
+    return FRAME_BASE_MISMATCH;
+  default:
+    return FRAME_FLASH_ERROR;
+  }
+}
+
+// Answers END from the writer task, hashing and setting the boot partition
+// can take longer than a GATT callback should block
+static void _frameDone(int state) {
+  if (!frameEnding) {
+    return; // not a framed transfer, or aborted
+  }
+  frameEnding = false;
+  if (state == OTA_DONE) {
+    status = STATUS_READY;
+    _frameStatus(framedCharacteristic, FRAME_DONE);
+  } else {
+    status = STATUS_ERROR;
+    _frameStatus(framedCharacteristic, _frameError());
+  }
+}
+
+// An image of whole packets has no short packet to end it; a truncated one
+// fails the image check in the writer task
+static void _legacyEnd(void *arg) {
+  if (otaUpdate.state() == OTA_RUNNING && !otaUpdate.verifying()) {
+    otaUpdate.end();
+  }
+}
+
 void otaCallback::onWrite(BLECharacteristic *pCharacteristic) {
-  auto rxData = pCharacteristic->getValue();
-  if (!updateFlag) { // If it's the first packet of OTA since bootup, begin OTA
-    // Serial.println("Begin FW Update");
-    esp_ota_begin(esp_ota_get_next_update_partition(NULL), OTA_SIZE_UNKNOWN,
-                  &otaHandler);
-    updateFlag = true;
-    status     = STATUS_UPDATING;
+  if (!_otaBegin()) {
+    return;
   }
   if (_p_ble != NULL) {
-    if (rxData.length() > 0) {
-      esp_ota_write(otaHandler, rxData.c_str(), rxData.length());
-      bytesReceived = bytesReceived + rxData.length();
-      if (rxData.length() != FULL_PACKET) {
-        esp_ota_end(otaHandler);
-        // Serial.println("End FW Update");
-        if (ESP_OK == esp_ota_set_boot_partition(
-                          esp_ota_get_next_update_partition(NULL))) {
-          status = STATUS_READY;
-        } else {
-          // Serial.println("Upload Error");
-        }
-      }
+    size_t length = pCharacteristic->getLength();
+    if (length > 0) {
+      otaUpdate.write(pCharacteristic->getData(), length);
+    }
+    esp_timer_stop(legacyEndTimer);
+    if (length == FULL_PACKET) {
+      esp_timer_start_once(legacyEndTimer, BLE_LEGACY_END_MS * 1000ULL);
+    } else {
+      otaUpdate.end(); // the writer task sets the boot partition
     }
   }
 
@@ -69,6 +205,119 @@ void otaCallback::onWrite(BLECharacteristic *pCharacteristic) {
   pCharacteristic->notify();
 }
 
+// Write-without-response stream: the client sends back to back packets of
+// any fixed size up to MTU - 3 and waits for an ack every BLE_ACK_WINDOW
+// packets. A shorter (or empty) packet ends the image.
+void otaStreamCallback::onWrite(BLECharacteristic *pCharacteristic) {
+  if (!_otaBegin()) {
+    return;
+  }
+  size_t length = pCharacteristic->getLength();
+  if (streamPacket == 0) {
+    streamPacket = length;
+  }
+  if (length > 0 && !otaUpdate.write(pCharacteristic->getData(), length)) {
+    _otaAck(pCharacteristic);
+    return;
+  }
+  if (length < streamPacket || length == 0) {
+    otaUpdate.end();
+    _otaAck(pCharacteristic);
+  } else if (++streamCount >= BLE_ACK_WINDOW) {
+    streamCount = 0;
+    _otaAck(pCharacteristic);
+  }
+}
+
+void otaFramedCallback::onWrite(BLECharacteristic *pCharacteristic) {
+  const uint8_t *data = pCharacteristic->getData();
+  size_t length       = pCharacteristic->getLength();
+  if (length == 0) {
+    return;
+  }
+  switch (data[0]) {
+  case FRAME_BEGIN:
+    if (length < FRAME_BEGIN_SIZE) {
+      _frameStatus(pCharacteristic, FRAME_SIZE_ERROR);
+      return;
+    }
+    if (!otaUpdate.begin(_le32(&data[1]), &data[5])) {
+      status = STATUS_ERROR;
+      _frameStatus(pCharacteristic, FRAME_FLASH_ERROR);
+      return;
+    }
+    updateFlag    = true;
+    frameSeq      = 0;
+    frameCount    = 0;
+    frameRejected = false;
+    status        = STATUS_UPDATING;
+    _frameStatus(pCharacteristic, FRAME_OK); // offset to continue from
+    return;
+  case FRAME_DATA: {
+    if (!otaUpdate.verifying() || otaUpdate.state() != OTA_RUNNING) {
+      _frameStatus(pCharacteristic, otaUpdate.state() == OTA_ERROR
+                                        ? _frameError()
+                                        : FRAME_NOT_STARTED);
+      return;
+    }
+    if (length < FRAME_DATA_HEADER) {
+      return;
+    }
+    uint16_t seq = data[1] | (data[2] << 8);
+    if (seq != frameSeq) {
+      if (!frameRejected) { // report once, then wait for the resend
+        frameRejected = true;
+        frameCount    = 0; // windows restart at the resent frame
+        _frameStatus(pCharacteristic, FRAME_SEQ_ERROR);
+      }
+      return;
+    }
+    const uint8_t *payload = &data[FRAME_DATA_HEADER];
+    size_t payloadLength   = length - FRAME_DATA_HEADER;
+    if (esp_rom_crc32_le(0, payload, payloadLength) != _le32(&data[3])) {
+      frameRejected = true;
+      frameCount    = 0;
+      _frameStatus(pCharacteristic, FRAME_CRC_ERROR);
+      return;
+    }
+    if (!otaUpdate.write(payload, payloadLength)) {
+      _frameStatus(pCharacteristic, _frameError());
+      return;
+    }
+    frameRejected = false;
+    frameSeq++;
+    if (++frameCount >= BLE_ACK_WINDOW) {
+      frameCount = 0;
+      _frameStatus(pCharacteristic, FRAME_OK);
+    }
+    return;
+  }
+  case FRAME_END:
+    if (otaUpdate.state() != OTA_RUNNING) {
+      _frameStatus(pCharacteristic, otaUpdate.state() == OTA_DONE
+                                        ? FRAME_DONE
+                                        : otaUpdate.state() == OTA_ERROR
+                                              ? _frameError()
+                                              : FRAME_NOT_STARTED);
+      return;
+    }
+    // the writer flushes at most OTA_RING_SIZE bytes, then hashes and
+    // checks the image before it becomes bootable and _frameDone() answers
+    frameEnding = true;
+    _frameStatus(pCharacteristic, FRAME_VERIFYING);
+    otaUpdate.end();
+    return;
+  case FRAME_ABORT:
+    frameEnding = false;
+    otaUpdate.abort();
+    otaUpdate.wait(OTA_QUEUE_TIMEOUT_MS);
+    updateFlag = false;
+    status     = STATUS_CONNECTED;
+    _frameStatus(pCharacteristic, FRAME_OK);
+    return;
+  }
+}
+
 //
 // Constructor
 BLE::BLE(void) {}
@@ -82,6 +331,7 @@ BLE::~BLE(void) {}
 bool BLE::begin(const char *localName = "Watchy BLE OTA") {
   // Create the BLE Device
   BLEDevice::init(localName);
+  BLEDevice::setMTU(BLE_OTA_MTU);
 
   // Create the BLE Server
   pServer = BLEDevice::createServer();
@@ -108,6 +358,29 @@ bool BLE::begin(const char *localName = "Watchy BLE OTA") {
   pOtaCharacteristic->addDescriptor(new BLE2902());
   pOtaCharacteristic->setCallbacks(new otaCallback(this));
 
+  pOtaStreamCharacteristic = pService->createCharacteristic(
+      CHARACTERISTIC_UUID_FW_STREAM, BLECharacteristic::PROPERTY_NOTIFY |
+                                         BLECharacteristic::PROPERTY_WRITE_NR);
+
+  pOtaStreamCharacteristic->addDescriptor(new BLE2902());
+  pOtaStreamCharacteristic->setCallbacks(new otaStreamCallback());
+
+  pOtaFramedCharacteristic = pService->createCharacteristic(
+      CHARACTERISTIC_UUID_FW_FRAMED,
+      BLECharacteristic::PROPERTY_NOTIFY | BLECharacteristic::PROPERTY_WRITE |
+          BLECharacteristic::PROPERTY_WRITE_NR);
+
+  pOtaFramedCharacteristic->addDescriptor(new BLE2902());
+  pOtaFramedCharacteristic->setCallbacks(new otaFramedCallback());
+  framedCharacteristic = pOtaFramedCharacteristic;
+  otaUpdate.onDone(_frameDone);
+  if (legacyEndTimer == NULL) {
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback                = _legacyEnd;
+    timerArgs.name                    = "ota_legacy_end";
+    esp_timer_create(&timerArgs, &legacyEndTimer);
+  }
+
   // Start the service(s)
   pESPOTAService->start();
   pService->start();
@@ -125,6 +398,14 @@ bool BLE::begin(const char *localName = "Watchy BLE OTA") {
   return true;
 }
 
-int BLE::updateStatus() { return status; }
+int BLE::updateStatus() {
+  if (otaUpdate.state() == OTA_DONE) {
+    return STATUS_READY;
+  }
+  if (otaUpdate.state() == OTA_ERROR) {
+    return STATUS_ERROR;
+  }
+  return status;
+}
 
-int BLE::howManyBytes() { return bytesReceived; }
+int BLE::howManyBytes() { return otaUpdate.written(); }
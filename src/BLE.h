@@ -8,7 +8,10 @@
 #include <BLEServer.h>
 #include <BLEUtils.h>
 
-#include "esp_ota_ops.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+#include "OTAUpdate.h"
 
 #include "config.h"
 
@@ -34,6 +37,8 @@ private:
   BLEService *pService                            = NULL;
   BLECharacteristic *pVersionCharacteristic       = NULL;
   BLECharacteristic *pOtaCharacteristic           = NULL;
+  BLECharacteristic *pOtaStreamCharacteristic     = NULL;
+  BLECharacteristic *pOtaFramedCharacteristic     = NULL;
   BLECharacteristic *pWatchFaceNameCharacteristic = NULL;
 };
 
@@ -0,0 +1,115 @@
+#include "BLEBeacon.h"
+
+#define HCI_COMMAND        0x01
+#define HCI_EVENT          0x04
+#define HCI_EVT_CMD_DONE   0x0E
+#define HCI_RESET          0x0C03
+#define HCI_LE_ADV_PARAMS  0x2006
+#define HCI_LE_ADV_DATA    0x2008
+#define HCI_LE_ADV_ENABLE  0x200A
+#define HCI_TIMEOUT_MS     100
+#define ADV_NONCONN_IND    0x03
+
+static volatile uint8_t commandsDone = 0;
+
+static void _hciSendAvailable() {}
+
+static int _hciReceive(uint8_t *data, uint16_t length) {
+  if (length >= 2 && data[0] == HCI_EVENT && data[1] == HCI_EVT_CMD_DONE) {
+    commandsDone++;
+  }
+  return 0;
+}
+
+static esp_vhci_host_callback_t vhciCallbacks = {_hciSendAvailable,
+                                                 _hciReceive};
+
+// Sends one command and waits for its Command Complete event
+bool BLEBeacon::_command(uint16_t opcode, const uint8_t *params,
+                         uint8_t length) {
+  uint8_t packet[4 + 32];
+  packet[0] = HCI_COMMAND;
+  packet[1] = opcode;
+  packet[2] = opcode >> 8;
+  packet[3] = length;
+  if (length > 0) {
+    memcpy(&packet[4], params, length);
+  }
+  uint32_t start = millis();
+  while (!esp_vhci_host_check_send_available()) {
+    if (millis() - start > HCI_TIMEOUT_MS) {
+      return false;
+    }
+    delay(1);
+  }
+  uint8_t done = commandsDone;
+  esp_vhci_host_send_packet(packet, 4 + length);
+  while (commandsDone == done) {
+    if (millis() - start > HCI_TIMEOUT_MS) {
+      return false;
+    }
+    delay(1);
+  }
+  return true;
+}
+
+bool BLEBeacon::broadcast(const beaconData &data, uint16_t durationMs) {
+  if (!btStarted() && !btStart()) {
+    return false;
+  }
+  esp_vhci_host_register_callback(&vhciCallbacks);
+
+  // interval min and max, type, own and peer address, channels, filter
+  uint8_t params[15] = {BLE_BEACON_ADV_INTERVAL & 0xFF,
+                        BLE_BEACON_ADV_INTERVAL >> 8,
+                        BLE_BEACON_ADV_INTERVAL & 0xFF,
+                        BLE_BEACON_ADV_INTERVAL >> 8,
+                        ADV_NONCONN_IND,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0,
+                        0x07,
+                        0};
+
+  uint8_t adv[32] = {0};
+  uint8_t *p      = &adv[1];
+  *p++            = 2; // flags: LE only, general discoverable
+  *p++            = 0x01;
+  *p++            = 0x06;
+  *p++            = BEACON_DATA_SIZE + 1;
+  *p++            = 0xFF; // manufacturer specific data
+  *p++            = 0xFF;
+  *p++            = 0xFF;
+  *p++            = 'W';
+  *p++            = BEACON_VERSION;
+  *p++            = data.battery;
+  *p++            = data.steps;
+  *p++            = data.steps >> 8;
+  *p++            = data.steps >> 16;
+  *p++            = data.steps >> 24;
+  *p++            = data.syncAge;
+  *p++            = data.syncAge >> 8;
+  *p++            = SOFTWARE_VERSION_MAJOR;
+  *p++            = SOFTWARE_VERSION_MINOR;
+  *p++            = SOFTWARE_VERSION_PATCH;
+  *p++            = data.sequence;
+  adv[0]          = p - &adv[1];
+
+  uint8_t enable  = 1;
+  uint8_t disable = 0;
+  bool sent = _command(HCI_RESET, NULL, 0) &&
+              _command(HCI_LE_ADV_PARAMS, params, sizeof(params)) &&
+              _command(HCI_LE_ADV_DATA, adv, sizeof(adv)) &&
+              _command(HCI_LE_ADV_ENABLE, &enable, 1);
+  if (sent) {
+    delay(durationMs);
+    _command(HCI_LE_ADV_ENABLE, &disable, 1);
+  }
+  btStop();
+  return sent;
+}
@@ -0,0 +1,36 @@
+#ifndef _BLE_BEACON_H_
+#define _BLE_BEACON_H_
+
+#include "Arduino.h"
+#include "esp_bt.h"
+
+#include "config.h"
+
+// Telemetry broadcast as non-connectable advertisements, decoded by
+// extras/tools/beacon_decode.py. Manufacturer data, little endian:
+//  0  company id 0xFFFF (test id)  2  'W'  3  version
+//  4  battery %  5  steps (u32)  9  minutes since the last time sync (u16,
+//  0xFFFF never)  11  firmware major minor patch  14  sequence
+#define BEACON_VERSION   1
+#define BEACON_DATA_SIZE 15
+
+typedef struct beaconData {
+  uint8_t battery;
+  uint32_t steps;
+  uint16_t syncAge;
+  uint8_t sequence;
+} beaconData;
+
+// Talks HCI to the controller directly, without starting the Bluedroid
+// host, so a broadcast costs the controller start and a few advertising
+// events rather than a full BLE bring-up.
+class BLEBeacon {
+public:
+  static bool broadcast(const beaconData &data, uint16_t durationMs);
+
+private:
+  static bool _command(uint16_t opcode, const uint8_t *params,
+                       uint8_t length);
+};
+
+#endif
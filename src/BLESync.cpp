@@ -0,0 +1,95 @@
+#include "BLESync.h"
+#include "esp_timer.h"
+
+#define SERVICE_UUID_SYNC           "86b12870-4b70-4893-8ce6-9864fc00374d"
+#define CHARACTERISTIC_UUID_REQUEST "86b12871-4b70-4893-8ce6-9864fc00374d"
+#define CHARACTERISTIC_UUID_RECORD  "86b12872-4b70-4893-8ce6-9864fc00374d"
+
+static uint32_t syncNonce         = 0;
+static volatile bool syncReceived = false;
+static weatherRecord syncRecord;
+static int64_t syncArrived = 0;
+
+class syncRecordCallback : public BLECharacteristicCallbacks {
+  void onWrite(BLECharacteristic *pCharacteristic) {
+    weatherRecord record;
+    if (syncReceived ||
+        !parseWeatherRecord(pCharacteristic->getData(),
+                            pCharacteristic->getLength(), record) ||
+        record.nonce != syncNonce) {
+      return;
+    }
+    syncArrived  = esp_timer_get_time();
+    syncRecord   = record;
+    syncReceived = true;
+  }
+};
+
+//
+// Constructor
+BLESync::BLESync(void) {}
+
+//
+// Destructor
+BLESync::~BLESync(void) {}
+
+//
+// begin
+bool BLESync::begin(const char *localName, bool metric, uint32_t nonce,
+                    uint32_t passkey) {
+  if (passkey == 0 || passkey > 999999) {
+    return false;
+  }
+  syncNonce    = nonce;
+  syncReceived = false;
+
+  BLEDevice::init(localName);
+  // passkey entry on the phone, bonded so later syncs skip the pairing
+  BLEDevice::setEncryptionLevel(ESP_BLE_SEC_ENCRYPT_MITM);
+  security.setStaticPIN(passkey);
+  pServer  = BLEDevice::createServer();
+  pService = pServer->createService(SERVICE_UUID_SYNC);
+
+  uint8_t request[WEATHER_REQUEST_SIZE];
+  buildWeatherRequest(request, metric, nonce);
+  pRequestCharacteristic = pService->createCharacteristic(
+      CHARACTERISTIC_UUID_REQUEST, BLECharacteristic::PROPERTY_READ);
+  pRequestCharacteristic->setValue(request, WEATHER_REQUEST_SIZE);
+
+  pRecordCharacteristic = pService->createCharacteristic(
+      CHARACTERISTIC_UUID_RECORD, BLECharacteristic::PROPERTY_WRITE);
+  pRecordCharacteristic->setAccessPermissions(ESP_GATT_PERM_WRITE_ENC_MITM);
+  pRecordCharacteristic->setCallbacks(new syncRecordCallback());
+
+  pService->start();
+
+  // advertise fast, the window is only a few seconds
+  BLEAdvertising *pAdvertising = pServer->getAdvertising();
+  pAdvertising->addServiceUUID(SERVICE_UUID_SYNC);
+  pAdvertising->setMinInterval(BLE_SYNC_ADV_INTERVAL);
+  pAdvertising->setMaxInterval(BLE_SYNC_ADV_INTERVAL);
+  pAdvertising->start();
+  return true;
+}
+
+bool BLESync::poll(weatherRecord &record, int64_t &arrivedUs) {
+  if (!syncReceived) {
+    return false;
+  }
+  // give the client the write response before the radio goes off
+  delay(50);
+  record    = syncRecord;
+  arrivedUs = syncArrived;
+  return true;
+}
+
+bool BLESync::wait(uint32_t timeoutMs, weatherRecord &record,
+                   int64_t &arrivedUs) {
+  uint32_t start = millis();
+  while (!syncReceived && millis() - start < timeoutMs) {
+    delay(10);
+  }
+  return poll(record, arrivedUs);
+}
+
+void BLESync::end() { BLEDevice::deinit(false); }
@@ -0,0 +1,41 @@
+#ifndef _BLE_SYNC_H_
+#define _BLE_SYNC_H_
+
+#include "Arduino.h"
+
+#include <BLEDevice.h>
+#include <BLESecurity.h>
+#include <BLEServer.h>
+#include <BLEUtils.h>
+
+#include "WeatherRecord.h"
+#include "config.h"
+
+// Time and weather pushed by a phone or extras/tools/ble_sync.py. The
+// client reads the request characteristic (the same 8 byte request the UDP
+// proxy gets) and writes back a weather record carrying its nonce, time and
+// timezone, all within one short connection. The record can only be
+// written over a link encrypted after passkey pairing (the watch shows no
+// prompt, the phone enters the passkey once and bonds), so the nonce only
+// guards against replays. begin() is false without a 6 digit passkey.
+class BLESync {
+public:
+  BLESync(void);
+  ~BLESync(void);
+
+  bool begin(const char *localName, bool metric, uint32_t nonce,
+             uint32_t passkey);
+  bool poll(weatherRecord &record, int64_t &arrivedUs); // does not block
+  bool wait(uint32_t timeoutMs, weatherRecord &record, int64_t &arrivedUs);
+  void end();
+
+private:
+  BLEServer *pServer = NULL;
+  BLESecurity security;
+
+  BLEService *pService                      = NULL;
+  BLECharacteristic *pRequestCharacteristic = NULL;
+  BLECharacteristic *pRecordCharacteristic  = NULL;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "DNSCache.h"
+
+#define DNS_PORT        53
+#define DNS_PACKET_SIZE 512
+
+typedef struct dnsCacheEntry {
+  char host[DNS_CACHE_HOST_LEN];
+  uint32_t ip;
+  time_t resolved;
+  time_t expires;
+} dnsCacheEntry;
+
+RTC_DATA_ATTR dnsCacheEntry dnsCache[DNS_CACHE_ENTRIES];
+
+bool DNSCache::resolve(const char *host, IPAddress &ip, time_t now) {
+  if (ip.fromString(host)) {
+    return true; // already an address
+  }
+  size_t hostLen = strlen(host);
+  dnsCacheEntry *slot = &dnsCache[0];
+  for (uint8_t i = 0; i < DNS_CACHE_ENTRIES; i++) {
+    dnsCacheEntry &entry = dnsCache[i];
+    if (strcmp(entry.host, host) == 0) {
+      // An RTC set backwards also invalidates the entry
+      if (entry.resolved <= now && now < entry.expires) {
+        ip = entry.ip;
+        return true;
+      }
+      slot = &entry;
+      break;
+    }
+    if (entry.expires < slot->expires) {
+      slot = &entry; // evict the entry closest to expiring
+    }
+  }
+  uint32_t ttl;
+  if (!_query(host, ip, ttl)) {
+    // Fall back to the system resolver, which does not report the TTL
+    if (!WiFi.hostByName(host, ip)) {
+      return false;
+    }
+    ttl = DNS_CACHE_DEFAULT_TTL;
+  }
+  ttl = constrain(ttl, DNS_CACHE_MIN_TTL, DNS_CACHE_MAX_TTL);
+  if (hostLen < DNS_CACHE_HOST_LEN) {
+    memcpy(slot->host, host, hostLen + 1);
+    slot->ip       = ip;
+    slot->resolved = now;
+    slot->expires  = now + ttl;
+  }
+  return true;
+}
+
+void DNSCache::invalidate(const char *host) {
+  for (uint8_t i = 0; i < DNS_CACHE_ENTRIES; i++) {
+    if (strcmp(dnsCache[i].host, host) == 0) {
+      dnsCache[i].expires = 0;
+    }
+  }
+}
+
+// Returns the position after the (possibly compressed) name at pos, or -1
+static int _skipName(const uint8_t *p, int pos, int len) {
+  while (pos < len) {
+    uint8_t label = p[pos];
+    if ((label & 0xC0) == 0xC0) {
+      return pos + 2;
+    }
+    if (label == 0) {
+      return pos + 1;
+    }
+    pos += label + 1;
+  }
+  return -1;
+}
+
+// Single A query to the DHCP provided server, done by hand because lwIP's
+// resolver does not hand out the record TTL
+bool DNSCache::_query(const char *host, IPAddress &ip, uint32_t &ttl) {
+  uint8_t packet[DNS_PACKET_SIZE];
+  uint16_t id = esp_random();
+  int len     = 0;
+  memset(packet, 0, 12);
+  packet[0] = id >> 8;
+  packet[1] = id;
+  packet[2] = 0x01; // recursion desired
+  packet[5] = 1;    // one question
+  len       = 12;
+  const char *label = host;
+  while (*label) {
+    const char *dot = strchr(label, '.');
+    int labelLen    = dot ? dot - label : strlen(label);
+    if (labelLen == 0 || labelLen > 63 || len + labelLen + 6 > DNS_PACKET_SIZE) {
+      return false;
+    }
+    packet[len++] = labelLen;
+    memcpy(&packet[len], label, labelLen);
+    len += labelLen;
+    label += labelLen;
+    if (*label == '.') {
+      label++;
+    }
+  }
+  packet[len++] = 0;
+  packet[len++] = 0;
+  packet[len++] = 1; // type A
+  packet[len++] = 0;
+  packet[len++] = 1; // class IN
+
+  WiFiUDP udp;
+  udp.begin(49152 + (esp_random() & 0x3FFF));
+  udp.beginPacket(WiFi.dnsIP(), DNS_PORT);
+  udp.write(packet, len);
+  if (!udp.endPacket()) {
+    udp.stop();
+    return false;
+  }
+  uint32_t start = millis();
+  len            = 0;
+  while (millis() - start < DNS_TIMEOUT_MS) {
+    if (udp.parsePacket() > 0) {
+      len = udp.read(packet, DNS_PACKET_SIZE);
+      if (len >= 12 && packet[0] == (uint8_t)(id >> 8) &&
+          packet[1] == (uint8_t)id) {
+        break;
+      }
+      len = 0; // not our reply
+    }
+    delay(1);
+  }
+  udp.stop();
+  if (len < 12 || !(packet[2] & 0x80) || (packet[3] & 0x0F) != 0) {
+    return false; // timeout, not a response or an error rcode
+  }
+  uint16_t answers = (packet[6] << 8) | packet[7];
+  int pos          = _skipName(packet, 12, len);
+  if (pos < 0) {
+    return false;
+  }
+  pos += 4; // question type and class
+  // The address is only valid as long as every record of a CNAME chain is
+  ttl = UINT32_MAX;
+  for (uint16_t i = 0; i < answers; i++) {
+    pos = _skipName(packet, pos, len);
+    if (pos < 0 || pos + 10 > len) {
+      return false;
+    }
+    uint16_t type     = (packet[pos] << 8) | packet[pos + 1];
+    uint16_t cls      = (packet[pos + 2] << 8) | packet[pos + 3];
+    uint32_t recordTTL = ((uint32_t)packet[pos + 4] << 24) |
+                         ((uint32_t)packet[pos + 5] << 16) |
+                         ((uint32_t)packet[pos + 6] << 8) | packet[pos + 7];
+    uint16_t rdLength = (packet[pos + 8] << 8) | packet[pos + 9];
+    pos += 10;
+    if (pos + rdLength > len) {
+      return false;
+    }
+    if (recordTTL < ttl) {
+      ttl = recordTTL;
+    }
+    if (type == 1 && cls == 1 && rdLength == 4) {
+      ip = IPAddress(packet[pos], packet[pos + 1], packet[pos + 2],
+                     packet[pos + 3]);
+      return true;
+    }
+    pos += rdLength;
+  }
+  return false;
+}
@@ -0,0 +1,22 @@
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "config.h"
+
+// Resolved host addresses kept in RTC memory across deep sleep, so later
+// sessions can connect without a DNS round trip until the record's TTL runs
+// out. Times are RTC times in seconds.
+class DNSCache {
+public:
+  static bool resolve(const char *host, IPAddress &ip, time_t now);
+  static void invalidate(const char *host);
+
+private:
+  static bool _query(const char *host, IPAddress &ip, uint32_t &ttl);
+};
+
+#endif
@@ -15,8 +15,7 @@
 // Link: https://github.com/sqfmi/Watchy
 
 #include "Display.h"
-
-RTC_DATA_ATTR bool displayFullInit       = true;
+#include "HardwareInfo.h"
 
 void WatchyDisplay::busyCallback(const void *) {
   gpio_wakeup_enable((gpio_num_t)DISPLAY_BUSY, GPIO_INTR_LOW_LEVEL);
@@ -37,7 +36,7 @@ WatchyDisplay::WatchyDisplay() :
 
 void WatchyDisplay::initWatchy() {
   // Watchy default initialization
-  init(0, displayFullInit, 2, true);
+  init(0, !watchyHardware.displayReady, 2, true);
 }
 
 void WatchyDisplay::asyncPowerOn() {
@@ -482,7 +481,7 @@ void WatchyDisplay::_Update_Full()
   _transferCommand(0x20);
   _endTransfer();
   _waitWhileBusy("_Update_Full", full_refresh_time);
-  displayFullInit = false;
+  watchyHardware.displayReady = true;
 }
 
 void WatchyDisplay::_Update_Part()
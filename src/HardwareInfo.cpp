@@ -0,0 +1,25 @@
+#include "HardwareInfo.h"
+
+#define HARDWARE_INFO_MAGIC 0x57484931 // "WHI1"
+
+RTC_DATA_ATTR hardwareInfo watchyHardware;
+
+uint32_t HardwareInfo::_signature() {
+  return HARDWARE_INFO_MAGIC ^ ((uint32_t)watchyHardware.boardRevision << 16 |
+                                (uint32_t)watchyHardware.rtcType << 8 |
+                                watchyHardware.bmaPresent);
+}
+
+bool HardwareInfo::valid() {
+  return watchyHardware.boardRevision != 0 &&
+         watchyHardware.signature == _signature();
+}
+
+void HardwareInfo::record(uint8_t boardRevision, uint8_t rtcType,
+                          bool bmaPresent) {
+  memset(&watchyHardware, 0, sizeof(watchyHardware));
+  watchyHardware.boardRevision = boardRevision;
+  watchyHardware.rtcType       = rtcType;
+  watchyHardware.bmaPresent    = bmaPresent;
+  watchyHardware.signature     = _signature();
+}
@@ -0,0 +1,30 @@
+#ifndef HARDWARE_INFO_H
+#define HARDWARE_INFO_H
+
+#include <Arduino.h>
+
+typedef struct hardwareInfo {
+  uint32_t signature;    // see HardwareInfo::valid()
+  uint8_t boardRevision; // 10, 15, 20 or 30, 255 when unknown
+  uint8_t rtcType;       // DS3231 or PCF8563, 0 for none (V3 uses its own)
+  bool bmaPresent;       // BMA423 answered on the bus
+  bool bmaConfigured;    // _bmaConfig() succeeded since the last record
+  bool displayReady;     // panel went through its full init
+} hardwareInfo;
+
+// What the watch is built from, probed once at cold boot and kept in RTC
+// memory so deep sleep wakes skip the I2C probes and GPIO reads. The
+// signature covers the probed fields; a mismatch (RTC memory lost or
+// corrupted) makes init() probe again and clears the state flags.
+class HardwareInfo {
+public:
+  static bool valid();
+  static void record(uint8_t boardRevision, uint8_t rtcType, bool bmaPresent);
+
+private:
+  static uint32_t _signature();
+};
+
+extern RTC_DATA_ATTR hardwareInfo watchyHardware;
+
+#endif
@@ -0,0 +1,458 @@
+#include "OTAUpdate.h"
+#include "esp_app_format.h"
+#include "esp_rom_crc.h"
+
+RTC_DATA_ATTR otaResumeState otaResume;
+
+static uint32_t _le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool OTAUpdate::begin() {
+  if (_state == OTA_RUNNING && !_aborted && _stopError == OTA_ERR_NONE) {
+    return true;
+  }
+  if (!_settle()) {
+    return false;
+  }
+  _verify = false;
+  return _start(0, 0);
+}
+
+bool OTAUpdate::begin(uint32_t size, const uint8_t *sha256) {
+  if (_state == OTA_RUNNING && !_aborted && _stopError == OTA_ERR_NONE &&
+      _verify && size == _size && memcmp(sha256, _sha256, 32) == 0) {
+    return true; // same image, carry on from what was received
+  }
+  if (!_settle()) {
+    return false;
+  }
+  _verify = true;
+  _size   = size;
+  memcpy(_sha256, sha256, 32);
+  mbedtls_sha256_init(&_hash);
+  const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+  if (partition != NULL && otaResume.size == size &&
+      memcmp(otaResume.sha256, sha256, 32) == 0 &&
+      otaResume.partition == partition->address && otaResume.offset <= size) {
+    mbedtls_sha256_clone(&_hash, &otaResume.hash);
+    return _start(otaResume.offset, otaResume.erased);
+  }
+  otaResume.size = 0;
+  mbedtls_sha256_starts_ret(&_hash, 0);
+  return _start(0, 0);
+}
+
+// A second writer task must not start on the ring, hash and inflate buffers
+// while the first one still frees them, so wait until it has returned.
+bool OTAUpdate::_settle() {
+  if (_writing && _state == OTA_RUNNING && _stopError == OTA_ERR_NONE) {
+    abort();
+  }
+  return wait(OTA_QUEUE_TIMEOUT_MS);
+}
+
+bool OTAUpdate::_start(uint32_t offset, uint32_t erased) {
+  if (_ring == NULL) {
+    _ring = xRingbufferCreate(OTA_RING_SIZE, RINGBUF_TYPE_BYTEBUF);
+    if (_ring == NULL) {
+      _fail(OTA_ERR_QUEUE);
+      return false;
+    }
+  }
+  _partition = esp_ota_get_next_update_partition(NULL);
+  if (_partition == NULL) {
+    _fail(OTA_ERR_FLASH);
+    return false;
+  }
+  _received          = offset;
+  _consumed          = offset;
+  _written           = offset;
+  _erased            = erased;
+  _ending            = false;
+  _aborted           = false;
+  _stopError         = OTA_ERR_NONE;
+  _error             = OTA_ERR_NONE;
+  _format            = offset > 0 ? OTA_FORMAT_RAW : OTA_FORMAT_UNKNOWN;
+  _headerLength      = 0;
+  _inflated          = 0;
+  _patch             = offset > 0 ? OTA_PATCH_NONE : OTA_PATCH_UNKNOWN;
+  _opLength          = 0;
+  _opRemaining       = 0;
+  _patchHeaderLength = 0;
+  _state             = OTA_RUNNING;
+  _writing           = true;
+  if (xTaskCreate(_writerTask, "ota_writer", 4096, this, OTA_WRITER_PRIORITY,
+                  NULL) != pdPASS) {
+    _writing = false;
+    _fail(OTA_ERR_QUEUE);
+    return false;
+  }
+  return true;
+}
+
+bool OTAUpdate::write(const uint8_t *data, size_t length) {
+  if (_state != OTA_RUNNING || _ending || _stopError != OTA_ERR_NONE) {
+    return false;
+  }
+  if (_verify && _received + length > _size) {
+    _stop(OTA_ERR_SIZE);
+    return false;
+  }
+  // blocks the BLE task when flash falls behind, which throttles the link
+  if (xRingbufferSend(_ring, data, length,
+                      pdMS_TO_TICKS(OTA_QUEUE_TIMEOUT_MS)) != pdTRUE) {
+    _stop(OTA_ERR_QUEUE);
+    return false;
+  }
+  _received = _received + length;
+  return true;
+}
+
+void OTAUpdate::end() { _ending = true; }
+
+void OTAUpdate::abort() { _aborted = true; }
+
+// Waits for the writer task to finish, after end() or abort().
+bool OTAUpdate::wait(uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (_writing) {
+    if (millis() - start > timeoutMs) {
+      return false;
+    }
+    delay(10);
+  }
+  return true;
+}
+
+void OTAUpdate::_fail(int error) {
+  if (_error == OTA_ERR_NONE) {
+    _error = error;
+  }
+  _state = OTA_ERROR;
+}
+
+// Producer side errors only ask the writer to stop, it alone sets the state
+void OTAUpdate::_stop(int error) {
+  if (_stopError == OTA_ERR_NONE) {
+    _stopError = error;
+  }
+}
+
+void OTAUpdate::_writerTask(void *param) {
+  static_cast<OTAUpdate *>(param)->_drain();
+  vTaskDelete(NULL);
+}
+
+// drops whatever is still queued so a retry starts clean
+void OTAUpdate::_discard() {
+  size_t size = 0;
+  void *item;
+  while ((item = xRingbufferReceiveUpTo(_ring, &size, 0, OTA_RING_SIZE)) !=
+         NULL) {
+    vRingbufferReturnItem(_ring, item);
+  }
+}
+
+void OTAUpdate::_drain() {
+  while (!_aborted && _stopError == OTA_ERR_NONE && _state == OTA_RUNNING) {
+    size_t size = 0;
+    void *item  = xRingbufferReceiveUpTo(_ring, &size, pdMS_TO_TICKS(100),
+                                         OTA_WRITE_CHUNK);
+    if (item != NULL) {
+      if (_verify) {
+        mbedtls_sha256_update_ret(&_hash, (const uint8_t *)item, size);
+      }
+      bool ok = _consume((const uint8_t *)item, size);
+      vRingbufferReturnItem(_ring, item);
+      if (!ok) {
+        break;
+      }
+      _consumed += size;
+      if (_verify && _format == OTA_FORMAT_RAW && _patch == OTA_PATCH_NONE) {
+        otaResume.size      = _size;
+        otaResume.partition = _partition->address;
+        otaResume.offset    = _consumed;
+        otaResume.erased    = _erased;
+        memcpy(otaResume.sha256, _sha256, 32);
+        mbedtls_sha256_clone(&otaResume.hash, &_hash);
+      }
+    } else if (_ending && _consumed == _received) {
+      break;
+    }
+  }
+  if (_stopError != OTA_ERR_NONE) {
+    _fail(_stopError);
+  }
+  bool finished = !_aborted && _state == OTA_RUNNING && _finish();
+  free(_inflator);
+  free(_window);
+  _inflator = NULL;
+  _window   = NULL;
+  if (_verify) {
+    mbedtls_sha256_free(&_hash);
+  }
+  // the bootloader check of the whole image happens here as well
+  if (finished && esp_ota_set_boot_partition(_partition) != ESP_OK) {
+    _fail(OTA_ERR_FLASH);
+    finished = false;
+  }
+  if (!finished) {
+    _discard();
+    if (_aborted) {
+      otaResume.size = 0;
+      _state         = OTA_IDLE;
+    } else {
+      if (_error == OTA_ERR_VERIFY || _error == OTA_ERR_FLASH) {
+        otaResume.size = 0; // nothing worth resuming
+      }
+      _state = OTA_ERROR;
+    }
+  } else {
+    otaResume.size = 0;
+    _state         = OTA_DONE;
+  }
+  if (_onDone != NULL) {
+    _onDone(_state);
+  }
+  _writing = false; // last touch of this object, begin() may start over
+}
+
+// Routes the incoming bytes by the first ones: a pack header switches to
+// inflating, anything else goes on to _output().
+bool OTAUpdate::_consume(const uint8_t *data, size_t length) {
+  if (_format == OTA_FORMAT_UNKNOWN) {
+    _format = data[0] == 'W' ? OTA_FORMAT_HEADER : OTA_FORMAT_RAW;
+  }
+  if (_format == OTA_FORMAT_HEADER) {
+    size_t take = min(length, OTA_PACK_HEADER_SIZE - _headerLength);
+    memcpy(&_header[_headerLength], data, take);
+    _headerLength += take;
+    data += take;
+    length -= take;
+    if (_headerLength < OTA_PACK_HEADER_SIZE) {
+      return true;
+    }
+    if (memcmp(_header, "WOTZ", 4) != 0) {
+      // not packed, e.g. a plain delta; hand the bytes on
+      _format = OTA_FORMAT_RAW;
+      if (!_output(_header, OTA_PACK_HEADER_SIZE)) {
+        return false;
+      }
+    } else if (!_startInflate()) {
+      return false;
+    }
+  }
+  if (_format == OTA_FORMAT_DEFLATE) {
+    return length == 0 || _inflate(data, length);
+  }
+  return _output(data, length);
+}
+
+// Second stage, after unpacking: a delta header switches to patching,
+// anything else is the image itself.
+bool OTAUpdate::_output(const uint8_t *data, size_t length) {
+  if (_patch == OTA_PATCH_UNKNOWN && length > 0) {
+    _patch = data[0] == 'W' ? OTA_PATCH_HEADER : OTA_PATCH_NONE;
+  }
+  if (_patch != OTA_PATCH_HEADER && _patch != OTA_PATCH_OPS) {
+    return _flash(data, length);
+  }
+  while (length > 0) {
+    if (_patch == OTA_PATCH_HEADER) {
+      size_t take = min(length, OTA_DELTA_HEADER_SIZE - _patchHeaderLength);
+      memcpy(&_patchHeader[_patchHeaderLength], data, take);
+      _patchHeaderLength += take;
+      data += take;
+      length -= take;
+      if (_patchHeaderLength == OTA_DELTA_HEADER_SIZE && !_startPatch()) {
+        return false;
+      }
+    } else if (_opRemaining > 0) {
+      size_t take = min(length, (size_t)_opRemaining);
+      if (!_flash(data, take)) {
+        return false;
+      }
+      _opRemaining -= take;
+      data += take;
+      length -= take;
+    } else {
+      _op[_opLength++] = *data++;
+      length--;
+      size_t opSize = _op[0] == OTA_DELTA_COPY ? 9 : 5;
+      if (_op[0] != OTA_DELTA_COPY && _op[0] != OTA_DELTA_INSERT) {
+        _fail(OTA_ERR_FORMAT);
+        return false;
+      }
+      if (_opLength < opSize) {
+        continue;
+      }
+      _opLength = 0;
+      if (_op[0] == OTA_DELTA_INSERT) {
+        _opRemaining = _le32(&_op[1]);
+      } else if (!_copyOld(_le32(&_op[1]), _le32(&_op[5]))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The delta only applies to the firmware it was made against, checked by
+// the CRC of the running partition before anything is written.
+bool OTAUpdate::_startPatch() {
+  if (memcmp(_patchHeader, "WOTD", 4) != 0 ||
+      _patchHeader[4] != OTA_DELTA_VERSION) {
+    _fail(OTA_ERR_FORMAT);
+    return false;
+  }
+  _patchSize = _le32(&_patchHeader[8]);
+  _baseSize  = _le32(&_patchHeader[12]);
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  if (running == NULL || _baseSize > running->size) {
+    _fail(OTA_ERR_BASE);
+    return false;
+  }
+  uint32_t crc = 0;
+  for (uint32_t offset = 0; offset < _baseSize;
+       offset += sizeof(_copyBuffer)) {
+    size_t length = min((size_t)(_baseSize - offset), sizeof(_copyBuffer));
+    if (esp_partition_read(running, offset, _copyBuffer, length) != ESP_OK) {
+      _fail(OTA_ERR_FLASH);
+      return false;
+    }
+    crc = esp_rom_crc32_le(crc, _copyBuffer, length);
+  }
+  if (crc != _le32(&_patchHeader[16])) {
+    _fail(OTA_ERR_BASE);
+    return false;
+  }
+  _patch = OTA_PATCH_OPS;
+  return true;
+}
+
+bool OTAUpdate::_copyOld(uint32_t offset, uint32_t length) {
+  if (offset > _baseSize || length > _baseSize - offset) {
+    _fail(OTA_ERR_FORMAT);
+    return false;
+  }
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  while (length > 0) {
+    size_t take = min((size_t)length, sizeof(_copyBuffer));
+    if (esp_partition_read(running, offset, _copyBuffer, take) != ESP_OK) {
+      _fail(OTA_ERR_FLASH);
+      return false;
+    }
+    if (!_flash(_copyBuffer, take)) {
+      return false;
+    }
+    offset += take;
+    length -= take;
+  }
+  return true;
+}
+
+// Writes at the current partition offset, erasing whole sectors just ahead
+// of the data instead of the whole partition up front.
+bool OTAUpdate::_flash(const uint8_t *data, size_t length) {
+  uint32_t end = _written + length;
+  if (end > _partition->size) {
+    _fail(OTA_ERR_SIZE);
+    return false;
+  }
+  if (_written == 0 && length > 0 && data[0] != ESP_IMAGE_HEADER_MAGIC) {
+    _fail(OTA_ERR_FORMAT);
+    return false;
+  }
+  if (end > _erased) {
+    uint32_t to = (end + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+    if (esp_partition_erase_range(_partition, _erased, to - _erased) !=
+        ESP_OK) {
+      _fail(OTA_ERR_FLASH);
+      return false;
+    }
+    _erased = to;
+  }
+  if (esp_partition_write(_partition, _written, data, length) != ESP_OK) {
+    _fail(OTA_ERR_FLASH);
+    return false;
+  }
+  _written = end;
+  return true;
+}
+
+bool OTAUpdate::_startInflate() {
+  uint8_t windowBits = _header[5];
+  if (memcmp(_header, "WOTZ", 4) != 0 || _header[4] != OTA_PACK_VERSION ||
+      windowBits < 9 || windowBits > OTA_INFLATE_WINDOW_BITS) {
+    _fail(OTA_ERR_FORMAT);
+    return false;
+  }
+  _imageSize = _le32(&_header[8]);
+  // the window only has to cover the packer's window, both powers of two
+  _windowSize = 1 << windowBits;
+  _windowPos  = 0;
+  _inflator   = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+  _window     = (uint8_t *)malloc(_windowSize);
+  if (_inflator == NULL || _window == NULL) {
+    _fail(OTA_ERR_QUEUE);
+    return false;
+  }
+  tinfl_init(_inflator);
+  _inflateStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+  _format        = OTA_FORMAT_DEFLATE;
+  return true;
+}
+
+bool OTAUpdate::_inflate(const uint8_t *data, size_t length) {
+  while (length > 0 || _inflateStatus == TINFL_STATUS_HAS_MORE_OUTPUT) {
+    if (_inflateStatus == TINFL_STATUS_DONE) {
+      _fail(OTA_ERR_FORMAT); // data after the end of the stream
+      return false;
+    }
+    size_t in      = length;
+    size_t out     = _windowSize - _windowPos;
+    _inflateStatus = tinfl_decompress(_inflator, data, &in, _window,
+                                      _window + _windowPos, &out,
+                                      TINFL_FLAG_HAS_MORE_INPUT);
+    if (_inflateStatus < 0 || _inflated + out > _imageSize) {
+      _fail(OTA_ERR_FORMAT);
+      return false;
+    }
+    if (out > 0 && !_output(_window + _windowPos, out)) {
+      return false;
+    }
+    _inflated += out;
+    _windowPos = (_windowPos + out) & (_windowSize - 1);
+    data += in;
+    length -= in;
+    if (_inflateStatus == TINFL_STATUS_DONE) {
+      break;
+    }
+  }
+  return true;
+}
+
+// Everything has been queued and written; a packed image must also have
+// inflated to exactly its announced size, a delta must have rebuilt its
+// whole image and a verified transfer must match its size and SHA-256.
+bool OTAUpdate::_finish() {
+  if (_format == OTA_FORMAT_HEADER ||
+      (_format == OTA_FORMAT_DEFLATE &&
+       (_inflateStatus != TINFL_STATUS_DONE || _inflated != _imageSize)) ||
+      _patch == OTA_PATCH_HEADER ||
+      (_patch == OTA_PATCH_OPS &&
+       (_opLength > 0 || _opRemaining > 0 || _written != _patchSize))) {
+    _fail(OTA_ERR_FORMAT);
+    return false;
+  }
+  if (_verify) {
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&_hash, digest);
+    if (_consumed != _size || memcmp(digest, _sha256, 32) != 0) {
+      _fail(OTA_ERR_VERIFY);
+      return false;
+    }
+  }
+  return true;
+}
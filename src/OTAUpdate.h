@@ -0,0 +1,158 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+#include "freertos/ringbuf.h"
+#include "mbedtls/sha256.h"
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/miniz.h"
+#else
+#include "esp32/rom/miniz.h"
+#endif
+#include "config.h"
+
+#define OTA_IDLE    0
+#define OTA_RUNNING 1
+#define OTA_DONE    2
+#define OTA_ERROR   3
+
+#define OTA_ERR_NONE   0
+#define OTA_ERR_FLASH  1 // erase/write failed or the image does not boot
+#define OTA_ERR_FORMAT 2 // bad pack header or deflate stream
+#define OTA_ERR_SIZE   3 // more data than announced
+#define OTA_ERR_VERIFY 4 // size or SHA-256 mismatch
+#define OTA_ERR_QUEUE  5 // writer task stalled
+#define OTA_ERR_BASE   6 // delta made against other firmware than running
+
+// Called from the writer task once it has finished, with the final state
+typedef void (*otaDoneCallback)(int state);
+
+// Images packed by extras/tools/ota_pack.py start with this header (little
+// endian), followed by a raw deflate stream:
+//  0  'W' 'O' 'T' 'Z'  4  version  5  window bits  6  reserved (u16)
+//  8  unpacked image size (u32)
+// Anything else is written to flash as is.
+#define OTA_PACK_HEADER_SIZE 12
+#define OTA_PACK_VERSION     1
+
+#define OTA_FORMAT_UNKNOWN 0
+#define OTA_FORMAT_RAW     1
+#define OTA_FORMAT_HEADER  2 // collecting the pack header
+#define OTA_FORMAT_DEFLATE 3
+
+// After unpacking, a delta image made by extras/tools/ota_delta.py starts
+//  0  'W' 'O' 'T' 'D'  4  version  5  reserved (3)
+//  8  new image size (u32)  12  old image size (u32)
+// 16  CRC-32 of the first old image size bytes of the running partition
+// and continues with operations that rebuild the new image in order:
+//  01 offset (u32) length (u32)   copy from the running partition
+//  02 length (u32) bytes          insert literal bytes
+#define OTA_DELTA_HEADER_SIZE 20
+#define OTA_DELTA_VERSION     1
+#define OTA_DELTA_COPY        0x01
+#define OTA_DELTA_INSERT      0x02
+
+#define OTA_PATCH_UNKNOWN 0
+#define OTA_PATCH_NONE    1
+#define OTA_PATCH_HEADER  2 // collecting the delta header
+#define OTA_PATCH_OPS     3
+
+// Progress of a verified transfer, kept in RTC memory so a plain image can
+// resume where it stopped even after deep sleep. Packed and delta images
+// only resume within the same boot, their decoder state is not kept.
+typedef struct otaResumeState {
+  uint32_t size; // 0 when there is nothing to resume
+  uint8_t sha256[32];
+  uint32_t partition; // target partition address
+  uint32_t offset;    // bytes hashed and on flash
+  uint32_t erased;    // flash erased up to here
+  mbedtls_sha256_context hash;
+} otaResumeState;
+
+// Streams a firmware image into the next OTA partition. The BLE callback
+// only queues data in a ring buffer; a separate task inflates packed images,
+// applies delta images against the running firmware and erases and writes
+// flash, so the radio never waits on the flash.
+//
+// begin() takes an image of unknown size that is made bootable as soon as
+// it ends. begin(size, sha256) checks the size and hash first and returns
+// the offset to continue from in received().
+class OTAUpdate {
+public:
+  bool begin();
+  bool begin(uint32_t size, const uint8_t *sha256);
+  bool write(const uint8_t *data, size_t length);
+  void end();
+  void abort();
+  bool wait(uint32_t timeoutMs);
+  void onDone(otaDoneCallback callback) { _onDone = callback; }
+  int state() { return _state; }
+  int error() { return _error != OTA_ERR_NONE ? _error : _stopError; }
+  bool verifying() { return _verify; }
+  uint32_t received() { return _received; }
+  uint32_t written() { return _written; }
+  bool compressed() { return _format == OTA_FORMAT_DEFLATE; }
+  bool delta() { return _patch == OTA_PATCH_OPS; }
+
+private:
+  bool _settle();
+  bool _start(uint32_t offset, uint32_t erased);
+  static void _writerTask(void *param);
+  void _drain();
+  void _discard();
+  void _stop(int error);
+  void _fail(int error);
+  bool _consume(const uint8_t *data, size_t length);
+  bool _output(const uint8_t *data, size_t length);
+  bool _startPatch();
+  bool _copyOld(uint32_t offset, uint32_t length);
+  bool _flash(const uint8_t *data, size_t length);
+  bool _startInflate();
+  bool _inflate(const uint8_t *data, size_t length);
+  bool _finish();
+
+  RingbufHandle_t _ring             = NULL;
+  const esp_partition_t *_partition = NULL;
+  volatile int _state               = OTA_IDLE;
+  volatile int _error               = OTA_ERR_NONE;
+  volatile bool _ending             = false;
+  volatile bool _aborted            = false;
+  volatile bool _writing            = false; // the writer task is alive
+  volatile int _stopError           = OTA_ERR_NONE;
+  volatile uint32_t _received       = 0;
+  volatile uint32_t _written        = 0;
+  otaDoneCallback _onDone           = NULL;
+  uint32_t _consumed                = 0;
+  uint32_t _erased                  = 0;
+
+  bool _verify   = false;
+  uint32_t _size = 0;
+  uint8_t _sha256[32];
+  mbedtls_sha256_context _hash;
+
+  uint8_t _format = OTA_FORMAT_UNKNOWN;
+  uint8_t _header[OTA_PACK_HEADER_SIZE];
+  size_t _headerLength          = 0;
+  uint32_t _imageSize           = 0;
+  tinfl_decompressor *_inflator = NULL;
+  tinfl_status _inflateStatus   = TINFL_STATUS_NEEDS_MORE_INPUT;
+  uint8_t *_window              = NULL; // circular output, also the dictionary
+  size_t _windowSize            = 0;
+  size_t _windowPos             = 0;
+  uint32_t _inflated            = 0;
+
+  uint8_t _patch = OTA_PATCH_UNKNOWN;
+  uint8_t _patchHeader[OTA_DELTA_HEADER_SIZE];
+  size_t _patchHeaderLength = 0;
+  uint32_t _patchSize       = 0;
+  uint32_t _baseSize        = 0;
+  uint8_t _op[9];
+  size_t _opLength      = 0;
+  uint32_t _opRemaining = 0; // literal bytes left in the current insert
+  uint8_t _copyBuffer[256];
+};
+
+#endif
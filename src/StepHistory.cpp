@@ -0,0 +1,105 @@
+#include "StepHistory.h"
+
+#define STEP_LOG_NAMESPACE "steps"
+
+RTC_DATA_ATTR stepDay stepToday;
+RTC_DATA_ATTR time_t stepLastUpdate = 0;
+RTC_DATA_ATTR uint32_t stepLastCounter;
+
+void StepHistory::update(time_t now, uint32_t counter) {
+  // The counter restarts at 0 after a sensor reset, count from there
+  uint32_t steps  = counter >= stepLastCounter ? counter - stepLastCounter
+                                               : counter;
+  stepLastCounter = counter;
+  if (stepLastUpdate == 0) {
+    steps = 0; // no time base for what the counter held before
+  }
+  time_t from = stepLastUpdate;
+  if (from != 0 && now < from &&
+      from - now <= (time_t)STEP_HISTORY_DAYS * SECS_PER_DAY) {
+    // RTC set backwards, e.g. a sync just after midnight: no time passed,
+    // the steps go to the current bucket and the open day is kept
+    _add(from, from, steps);
+    return;
+  }
+  if (from == 0 || now < from ||
+      now - from > (time_t)STEP_HISTORY_DAYS * SECS_PER_DAY) {
+    from = now; // first update or too long a jump, book it all now
+  }
+  _add(from, now, steps);
+  stepLastUpdate = now;
+}
+
+// Spreads steps over the hour buckets between from and to, closing every
+// day boundary crossed on the way
+void StepHistory::_add(time_t from, time_t to, uint32_t steps) {
+  time_t span        = max(to - from, (time_t)1);
+  time_t t           = from;
+  uint32_t remaining = steps;
+  do {
+    time_t end     = min((t / SECS_PER_HOUR + 1) * SECS_PER_HOUR, to);
+    uint32_t share =
+        end >= to ? remaining : (uint64_t)steps * (end - t) / span;
+    if (t / SECS_PER_DAY != stepToday.day) {
+      _closeDay();
+      memset(&stepToday, 0, sizeof(stepToday));
+      stepToday.day = t / SECS_PER_DAY;
+    }
+    uint8_t bucket = (t % SECS_PER_DAY) / SECS_PER_HOUR;
+    stepToday.hours[bucket] =
+        min((uint32_t)0xFFFF, stepToday.hours[bucket] + share);
+    remaining -= share;
+    t = end;
+  } while (t < to);
+}
+
+// Stores the finished day in the NVS ring, slot day % STEP_HISTORY_DAYS
+void StepHistory::_closeDay() {
+  if (stepToday.day == 0 || total(stepToday) == 0) {
+    return;
+  }
+  Preferences log;
+  if (!log.begin(STEP_LOG_NAMESPACE, false)) {
+    return;
+  }
+  char key[4];
+  snprintf(key, sizeof(key), "d%02u",
+           (unsigned)(stepToday.day % STEP_HISTORY_DAYS));
+  log.putBytes(key, &stepToday, sizeof(stepToday));
+  log.end();
+}
+
+uint32_t StepHistory::total(const stepDay &record) {
+  uint32_t steps = 0;
+  for (uint8_t i = 0; i < 24; i++) {
+    steps += record.hours[i];
+  }
+  return steps;
+}
+
+uint32_t StepHistory::today() { return total(stepToday); }
+
+uint16_t StepHistory::hour(uint8_t h) {
+  return h < 24 ? stepToday.hours[h] : 0;
+}
+
+bool StepHistory::day(uint16_t daysAgo, stepDay &out) {
+  if (stepLastUpdate == 0 || daysAgo >= STEP_HISTORY_DAYS) {
+    return false;
+  }
+  uint16_t wanted = stepLastUpdate / SECS_PER_DAY - daysAgo;
+  if (wanted == stepToday.day) {
+    out = stepToday;
+    return true;
+  }
+  Preferences log;
+  if (!log.begin(STEP_LOG_NAMESPACE, true)) {
+    return false;
+  }
+  char key[4];
+  snprintf(key, sizeof(key), "d%02u", (unsigned)(wanted % STEP_HISTORY_DAYS));
+  bool found = log.getBytes(key, &out, sizeof(out)) == sizeof(out) &&
+               out.day == wanted;
+  log.end();
+  return found;
+}
@@ -0,0 +1,34 @@
+#ifndef STEP_HISTORY_H
+#define STEP_HISTORY_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <TimeLib.h>
+#include "config.h"
+
+typedef struct stepDay {
+  uint16_t day; // days since 1970 in RTC (local) time, 0 for no data
+  uint16_t hours[24];
+} stepDay;
+
+// Steps per hour of the current day, kept in RTC memory and fed from the
+// BMA423 step counter on every RTC wake. Steps between two updates are
+// shared across the hours they span in proportion to the elapsed RTC time,
+// so a missed tick at midnight still closes the day correctly, and a clock
+// set back books its steps as if no time passed. Completed days move to a
+// ring of STEP_HISTORY_DAYS entries in NVS.
+class StepHistory {
+public:
+  static void update(time_t now, uint32_t counter);
+  static uint32_t today();
+  static uint16_t hour(uint8_t h);
+  // daysAgo 0 is today; false when nothing was recorded for that day
+  static bool day(uint16_t daysAgo, stepDay &out);
+  static uint32_t total(const stepDay &record);
+
+private:
+  static void _add(time_t from, time_t to, uint32_t steps);
+  static void _closeDay();
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "TLSClient.h"
+
+#include <fcntl.h>
+#include "mbedtls/platform.h"
+
+RTC_DATA_ATTR char tlsSessionHost[DNS_CACHE_HOST_LEN];
+RTC_DATA_ATTR uint16_t tlsSessionLength;
+RTC_DATA_ATTR uint8_t tlsSession[TLS_SESSION_SIZE];
+
+WatchyTLSClient::WatchyTLSClient() {}
+
+WatchyTLSClient::~WatchyTLSClient() { stop(); }
+
+void WatchyTLSClient::setCACert(const char *rootCA) { _rootCA = rootCA; }
+
+void WatchyTLSClient::setInsecure() { _insecure = true; }
+
+bool WatchyTLSClient::resumed() { return _resumed; }
+
+int WatchyTLSClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip, port, "", TLS_HANDSHAKE_TIMEOUT);
+}
+
+int WatchyTLSClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+  return connect(ip, port, "", timeout);
+}
+
+int WatchyTLSClient::connect(const char *host, uint16_t port) {
+  return connect(host, port, TLS_HANDSHAKE_TIMEOUT);
+}
+
+int WatchyTLSClient::connect(const char *host, uint16_t port,
+                             int32_t timeout) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    return 0;
+  }
+  return connect(ip, port, host, timeout);
+}
+
+int WatchyTLSClient::connect(IPAddress ip, uint16_t port, const char *host,
+                             int32_t timeout) {
+  stop();
+  if (_rootCA == NULL && !_insecure) {
+    return 0; // nothing to verify the server against
+  }
+  if (!WiFiClient::connect(ip, port, timeout)) {
+    return 0;
+  }
+  mbedtls_ssl_init(&_ssl);
+  mbedtls_ssl_config_init(&_conf);
+  mbedtls_ctr_drbg_init(&_drbg);
+  mbedtls_entropy_init(&_entropy);
+  mbedtls_x509_crt_init(&_ca);
+  _tlsConnected = true; // contexts need freeing from here on
+
+  int ret = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                                  NULL, 0);
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret == 0 && _rootCA != NULL) {
+    ret = mbedtls_x509_crt_parse(&_ca, (const unsigned char *)_rootCA,
+                                 strlen(_rootCA) + 1);
+    mbedtls_ssl_conf_ca_chain(&_conf, &_ca, NULL);
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  } else {
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+  }
+  if (ret == 0) {
+    mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+    mbedtls_ssl_conf_session_tickets(&_conf,
+                                     MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    ret = mbedtls_ssl_setup(&_ssl, &_conf);
+  }
+  if (ret == 0 && host[0] != '\0') {
+    ret = mbedtls_ssl_set_hostname(&_ssl, host);
+  }
+  if (ret != 0) {
+    stop();
+    return 0;
+  }
+
+  // Offer the saved session, the server falls back to a full handshake if it
+  // does not accept the ticket anymore
+  unsigned char offeredMaster[48];
+  bool offered = false;
+  if (tlsSessionLength > 0 && host[0] != '\0' &&
+      strcmp(tlsSessionHost, host) == 0) {
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_session_load(&session, tlsSession, tlsSessionLength) ==
+            0 &&
+        mbedtls_ssl_set_session(&_ssl, &session) == 0) {
+      memcpy(offeredMaster, session.master, sizeof(offeredMaster));
+      offered = true;
+    }
+    mbedtls_ssl_session_free(&session);
+  }
+
+  mbedtls_net_init(&_net);
+  _net.fd = fd();
+  fcntl(_net.fd, F_SETFL, fcntl(_net.fd, F_GETFL, 0) | O_NONBLOCK);
+  mbedtls_ssl_set_bio(&_ssl, &_net, mbedtls_net_send, mbedtls_net_recv, NULL);
+
+  uint32_t start = millis();
+  while ((ret = mbedtls_ssl_handshake(&_ssl)) != 0) {
+    if ((ret != MBEDTLS_ERR_SSL_WANT_READ &&
+         ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+        millis() - start > (uint32_t)timeout) {
+      tlsSessionLength = 0; // do not offer a session that just failed
+      stop();
+      return 0;
+    }
+    delay(2);
+  }
+  // An abbreviated handshake keeps the master secret of the offered session
+  _resumed = offered && memcmp(_ssl.session->master, offeredMaster,
+                               sizeof(offeredMaster)) == 0;
+  _saveSession(host);
+  return 1;
+}
+
+// Only the ticket, session id and master secret are needed to resume. The
+// server's certificate IDF keeps in the session by default would not fit
+// in RTC memory, so it is dropped before saving.
+void WatchyTLSClient::_saveSession(const char *host) {
+  size_t hostLength = strlen(host);
+  if (hostLength == 0 || hostLength >= DNS_CACHE_HOST_LEN) {
+    return;
+  }
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  size_t length = 0;
+  bool saved = mbedtls_ssl_get_session(&_ssl, &session) == 0;
+#if defined(MBEDTLS_X509_CRT_PARSE_C) && defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+  if (saved && session.peer_cert != NULL) {
+    mbedtls_x509_crt_free(session.peer_cert);
+    mbedtls_free(session.peer_cert);
+    session.peer_cert = NULL;
+  }
+#endif
+  if (saved && mbedtls_ssl_session_save(&session, tlsSession, TLS_SESSION_SIZE,
+                                        &length) == 0) {
+    memcpy(tlsSessionHost, host, hostLength + 1);
+    tlsSessionLength = length;
+  } else {
+    tlsSessionLength = 0; // ticket too big for RTC memory or no session
+  }
+  mbedtls_ssl_session_free(&session);
+}
+
+size_t WatchyTLSClient::write(uint8_t data) { return write(&data, 1); }
+
+size_t WatchyTLSClient::write(const uint8_t *buf, size_t size) {
+  if (!_tlsConnected) {
+    return 0;
+  }
+  size_t written = 0;
+  uint32_t start = millis();
+  while (written < size) {
+    int ret = mbedtls_ssl_write(&_ssl, buf + written, size - written);
+    if (ret > 0) {
+      written += ret;
+    } else if ((ret != MBEDTLS_ERR_SSL_WANT_READ &&
+                ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+               millis() - start > TLS_HANDSHAKE_TIMEOUT) {
+      stop();
+      break;
+    } else {
+      delay(1);
+    }
+  }
+  return written;
+}
+
+int WatchyTLSClient::available() {
+  if (!_tlsConnected) {
+    return 0;
+  }
+  int ret = mbedtls_ssl_read(&_ssl, NULL, 0); // process pending records
+  int pending = mbedtls_ssl_get_bytes_avail(&_ssl) + (_peeked >= 0 ? 1 : 0);
+  if (pending == 0 && ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ &&
+      ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    stop(); // closed by the peer or failed
+  }
+  return pending;
+}
+
+int WatchyTLSClient::read() {
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int WatchyTLSClient::read(uint8_t *buf, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  int count = 0;
+  if (_peeked >= 0) {
+    buf[count++] = _peeked;
+    _peeked      = -1;
+    if (--size == 0) {
+      return count;
+    }
+  }
+  if (!_tlsConnected) {
+    return count > 0 ? count : -1;
+  }
+  int ret = mbedtls_ssl_read(&_ssl, buf + count, size);
+  if (ret > 0) {
+    return count + ret;
+  }
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    stop();
+  }
+  return count > 0 ? count : -1;
+}
+
+int WatchyTLSClient::peek() {
+  if (_peeked < 0) {
+    _peeked = read();
+  }
+  return _peeked;
+}
+
+void WatchyTLSClient::flush() {}
+
+void WatchyTLSClient::stop() {
+  if (_tlsConnected) {
+    _free();
+  }
+  _peeked = -1;
+  WiFiClient::stop();
+}
+
+uint8_t WatchyTLSClient::connected() {
+  if (_tlsConnected) {
+    available(); // notices a close from the peer
+  }
+  return _tlsConnected || _peeked >= 0;
+}
+
+void WatchyTLSClient::_free() {
+  _tlsConnected = false;
+  mbedtls_ssl_free(&_ssl);
+  mbedtls_ssl_config_free(&_conf);
+  mbedtls_ctr_drbg_free(&_drbg);
+  mbedtls_entropy_free(&_entropy);
+  mbedtls_x509_crt_free(&_ca);
+  // the socket itself belongs to WiFiClient
+}
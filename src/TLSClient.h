@@ -0,0 +1,59 @@
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "config.h"
+
+// TLS client that keeps the last session ticket in RTC memory, so the next
+// connection to the same host after deep sleep does an abbreviated handshake.
+// Can be handed to HTTPClient::begin(WiFiClient &, String) like
+// WiFiClientSecure. connect() fails without a root CA unless setInsecure()
+// was called, which skips server verification.
+class WatchyTLSClient : public WiFiClient {
+public:
+  WatchyTLSClient();
+  ~WatchyTLSClient();
+
+  void setCACert(const char *rootCA);
+  void setInsecure(); // accept any certificate
+  int connect(IPAddress ip, uint16_t port, const char *host,
+              int32_t timeout = TLS_HANDSHAKE_TIMEOUT);
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+  int connect(const char *host, uint16_t port) override;
+  int connect(const char *host, uint16_t port, int32_t timeout) override;
+  bool resumed();
+
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+
+private:
+  void _free();
+  void _saveSession(const char *host);
+
+  const char *_rootCA = NULL;
+  bool _insecure      = false;
+  bool _tlsConnected  = false;
+  bool _resumed       = false;
+  int _peeked         = -1;
+  mbedtls_net_context _net;
+  mbedtls_ssl_context _ssl;
+  mbedtls_ssl_config _conf;
+  mbedtls_ctr_drbg_context _drbg;
+  mbedtls_entropy_context _entropy;
+  mbedtls_x509_crt _ca;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#include "TimeZone.h"
+
+long TimeZone::offsetAt(const tzTransition *table, uint16_t size, time_t utc,
+                        long fallback) {
+  if (table == NULL || size == 0 || (uint32_t)utc < table[0].utc) {
+    return fallback;
+  }
+  // Last entry starting at or before utc
+  uint16_t low  = 0;
+  uint16_t high = size;
+  while (high - low > 1) {
+    uint16_t mid = (low + high) / 2;
+    if (table[mid].utc <= (uint32_t)utc) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return table[low].offset * 60L;
+}
@@ -0,0 +1,22 @@
+#ifndef TIME_ZONE_H
+#define TIME_ZONE_H
+
+#include <stdint.h>
+#include <time.h>
+
+// One UTC offset change. Tables are generated from a POSIX TZ rule by
+// extras/tools/tz_table.py, sorted by utc and starting at 0, and live in
+// flash as static const arrays.
+typedef struct tzTransition {
+  uint32_t utc;   // UTC time the offset starts
+  int16_t offset; // minutes east of UTC from then on
+} tzTransition;
+
+class TimeZone {
+public:
+  // Offset in seconds east of UTC at utc, fallback for an empty table
+  static long offsetAt(const tzTransition *table, uint16_t size, time_t utc,
+                       long fallback);
+};
+
+#endif
@@ -3,9 +3,13 @@
 #ifdef ARDUINO_ESP32S3_DEV
   Watchy32KRTC Watchy::RTC;
   #define ACTIVE_LOW 0
+  #define ACC_INT_ACTIVE LOW // ext1 shares ANY_LOW with the buttons
+  #define ACC_FIFO_MAP BMA4_INTR2_MAP
 #else
   WatchyRTC Watchy::RTC;
   #define ACTIVE_LOW 1
+  #define ACC_INT_ACTIVE HIGH
+  #define ACC_FIFO_MAP BMA4_INTR1_MAP // see ACC_FIFO_MASK
 #endif
 GxEPD2_BW<WatchyDisplay, WatchyDisplay::HEIGHT> Watchy::display(
     WatchyDisplay{});
@@ -23,50 +27,151 @@ RTC_DATA_ATTR bool USB_PLUGGED_IN = false;
 RTC_DATA_ATTR tmElements_t bootTime;
 RTC_DATA_ATTR uint32_t lastIPAddress;
 RTC_DATA_ATTR char lastSSID[30];
+RTC_DATA_ATTR netStats networkStats;
+RTC_DATA_ATTR bool weatherOnFace = false;
+RTC_DATA_ATTR time_t lastTimeSync = 0; // RTC time of the last successful sync
+RTC_DATA_ATTR time_t lastBeacon   = 0;
+RTC_DATA_ATTR uint8_t beaconSequence;
+RTC_DATA_ATTR bool motionCapture = false; // FIFO watermark wakes
+RTC_DATA_ATTR Acfg trackingSavedCfg;       // accel config before tracking
+RTC_DATA_ATTR gestureStats gestureLatency;
+RTC_DATA_ATTR uint16_t rtcTickTransactions; // I2C with the RTC, last minute tick
+RTC_DATA_ATTR uint8_t secondsWake  = 0; // seconds between face wakes, 0 for off
+RTC_DATA_ATTR uint8_t rtcCountdown = 0; // seconds the RTC countdown runs at
+RTC_DATA_ATTR uint8_t tickMinute   = 0xFF; // minute of the last minute tick
+
+#define NET_JOB_NONE       0
+#define NET_JOB_CONNECTING 1
+#define NET_JOB_DONE       2
+#define NET_JOB_BLE        3 // waiting for a phone, WiFi after the window
+
+static int64_t radioOnSince = 0;
+static uint8_t netJob       = NET_JOB_NONE;
+static int64_t netJobStart  = 0;
+static weatherData shownWeather;
+static BLESync bleSyncJob;
+static bool rtcTick = false;
+static uint32_t rtcTickStart;
+static uint8_t stepCounterBytes[4];
+static i2cRequest stepCounterRead = {BMA4_I2C_ADDR_PRIMARY,
+                                     BMA4_STEP_CNT_OUT_0_ADDR,
+                                     true,
+                                     stepCounterBytes,
+                                     sizeof(stepCounterBytes),
+                                     I2C_OK};
+static bool stepCounterQueued = false;
+
+static time_t _rtcNow() {
+  tmElements_t tm;
+  Watchy::RTC.read(tm);
+  return makeTime(tm);
+}
+
+// Splits scheme://host[:port]/path into its connection parameters
+static bool _splitURL(const String &url, String &host, uint16_t &port,
+                      bool &secure) {
+  int schemeEnd = url.indexOf("://");
+  if (schemeEnd < 0) {
+    return false;
+  }
+  secure        = url.substring(0, schemeEnd).equalsIgnoreCase("https");
+  int hostStart = schemeEnd + 3;
+  int pathStart = url.indexOf('/', hostStart);
+  if (pathStart < 0) {
+    pathStart = url.length();
+  }
+  host      = url.substring(hostStart, pathStart);
+  port      = secure ? 443 : 80;
+  int colon = host.indexOf(':');
+  if (colon >= 0) {
+    port = host.substring(colon + 1).toInt();
+    host = host.substring(0, colon);
+  }
+  return host.length() > 0;
+}
+
+// Turns off the radios and accounts the time they were on
+static void _radioOff() {
+  WiFi.mode(WIFI_OFF);
+  btStop();
+  if (radioOnSince != 0) {
+    networkStats.radioOnMs += (esp_timer_get_time() - radioOnSince) / 1000;
+    radioOnSince = 0;
+  }
+}
 
 void Watchy::init(String datetime) {
   esp_sleep_wakeup_cause_t wakeup_reason;
   wakeup_reason = esp_sleep_get_wakeup_cause(); // get wake up reason
+  // With seconds or timer wakes not every RTC wake is a minute tick, the
+  // weather fetch then runs in the foreground from getWeatherData() and the
+  // step counter is read directly
   #ifdef ARDUINO_ESP32S3_DEV
-    Wire.begin(WATCHY_V3_SDA, WATCHY_V3_SCL);     // init i2c
+  bool minuteWake = wakeup_reason == ESP_SLEEP_WAKEUP_TIMER &&
+                    secondsWake == 0 && !Alarms::timing();
   #else
-    Wire.begin(SDA, SCL);                         // init i2c
+  bool minuteWake = wakeup_reason == ESP_SLEEP_WAKEUP_EXT0 &&
+                    secondsWake == 0 && !Alarms::timing();
   #endif
+  #ifdef ARDUINO_ESP32S3_DEV
+    WatchyI2C::begin(WATCHY_V3_SDA, WATCHY_V3_SCL); // init i2c
+  #else
+    WatchyI2C::begin(SDA, SCL);                     // init i2c
+  #endif
+  WatchyI2C::setClock(BMA4_I2C_ADDR_PRIMARY, BMA423_I2C_CLOCK_HZ);
+  if (!HardwareInfo::valid()) {
+    _probeHardware(); // cold boot, or RTC memory was lost
+  }
+  #ifdef ARDUINO_ESP32S3_DEV
   RTC.init();
+  #else
+  RTC.init(watchyHardware.rtcType); // no bus probe
+  #endif
+  if (minuteWake && watchyHardware.bmaConfigured) {
+    // the tick's step counter read runs while the display is set up
+    stepCounterQueued = WatchyI2C::readAsync(stepCounterRead);
+  }
   // Init the display since is almost sure we will use it
   display.epd2.initWatchy();
 
   switch (wakeup_reason) {
   #ifdef ARDUINO_ESP32S3_DEV
   case ESP_SLEEP_WAKEUP_TIMER: // RTC Alarm
+    RTC.tick();
   #else
-  case ESP_SLEEP_WAKEUP_EXT0: // RTC Alarm
+  case ESP_SLEEP_WAKEUP_EXT0: // RTC Alarm or countdown
+  case ESP_SLEEP_WAKEUP_TIMER: // seconds wake without an RTC countdown
+    rtcTickStart = RTC.transactions();
   #endif
     RTC.read(currentTime);
-    switch (guiState) {
-    case WATCHFACE_STATE:
-      showWatchFace(true); // partial updates on tick
-      if (settings.vibrateOClock) {
-        if (currentTime.Minute == 0) {
-          // The RTC wakes us up once per minute
-          vibMotor(75, 4);
-        }
+    // Seconds and timer wakes come between the minute ticks. Any other wake
+    // in the tick's minute came early and sleeps again until the tick.
+    if (currentTime.Minute == tickMinute) {
+      if (guiState == WATCHFACE_STATE && secondsWake > 0) {
+        showSeconds();
       }
-      break;
-    case MAIN_MENU_STATE:
-      // Return to watchface if in menu for more than one tick
-      if (alreadyInMenu) {
-        guiState = WATCHFACE_STATE;
-        showWatchFace(false);
-      } else {
-        alreadyInMenu = true;
+    } else {
+      #ifndef ARDUINO_ESP32S3_DEV
+      rtcTick = true;
+      #endif
+      if (minuteWake && guiState == WATCHFACE_STATE) {
+        _beginWeatherUpdate(); // associate while the face renders
       }
-      break;
+      _minuteTick();
     }
+    _runAlarms();
+    _runSeconds();
     break;
-  case ESP_SLEEP_WAKEUP_EXT1: // button Press
-    handleButtonPress();
+  case ESP_SLEEP_WAKEUP_EXT1: { // button Press, gesture or FIFO watermark
+    uint64_t wakeupBit = esp_sleep_get_ext1_wakeup_status();
+    if (wakeupBit & (ACC_INT_MASK | ACC_INT_2_MASK)) {
+      _handleAccelWake(wakeupBit & (ACC_INT_MASK | ACC_INT_2_MASK));
+    }
+    if (wakeupBit & ~(ACC_INT_MASK | ACC_INT_2_MASK)) {
+      handleButtonPress();
+    }
     break;
+  }
   #ifdef ARDUINO_ESP32S3_DEV
   case ESP_SLEEP_WAKEUP_EXT0: // USB plug in
     pinMode(USB_DET_PIN, INPUT);
@@ -87,6 +192,13 @@ void Watchy::init(String datetime) {
     gmtOffset = settings.gmtOffset;
     RTC.read(currentTime);
     RTC.read(bootTime);
+    // Trust the RTC's local time and only pick the offset it is in
+    gmtOffset = TimeZone::offsetAt(settings.tzTable, settings.tzTableSize,
+                                   makeTime(currentTime) - gmtOffset,
+                                   gmtOffset);
+    tickMinute = currentTime.Minute;
+    StepHistory::update(makeTime(currentTime), sensor.getCounter());
+    Alarms::due(makeTime(currentTime)); // start the alarm clock from now
     showWatchFace(false); // full update on reset
     vibMotor(75, 4);
     // For some reason, seems to be enabled on first boot
@@ -95,26 +207,94 @@ void Watchy::init(String datetime) {
   }
   deepSleep();
 }
+// The step counter read queued in init(), or a direct one
+static uint32_t _stepCounter() {
+  if (stepCounterQueued) {
+    stepCounterQueued = false;
+    if (WatchyI2C::wait(stepCounterRead, I2C_ASYNC_TIMEOUT_MS) == I2C_OK) {
+      return stepCounterBytes[0] | stepCounterBytes[1] << 8 |
+             (uint32_t)stepCounterBytes[2] << 16 |
+             (uint32_t)stepCounterBytes[3] << 24;
+    }
+  }
+  return sensor.getCounter();
+}
+
+void Watchy::_minuteTick() {
+  _applyTimeZone();
+  tickMinute = currentTime.Minute;
+  StepHistory::update(makeTime(currentTime), _stepCounter());
+  _updateSleepTracking();
+  switch (guiState) {
+  case WATCHFACE_STATE:
+    showWatchFace(true); // partial updates on tick
+    if (settings.vibrateOClock) {
+      if (currentTime.Minute == 0) {
+        // The RTC wakes us up once per minute
+        vibMotor(75, 4);
+      }
+    }
+    _finishWeatherUpdate();
+    if (settings.beaconInterval > 0 &&
+        makeTime(currentTime) - lastBeacon >=
+            (time_t)settings.beaconInterval * SECS_PER_MIN) {
+      broadcastTelemetry();
+    }
+    break;
+  case MAIN_MENU_STATE:
+    // Return to watchface if in menu for more than one tick
+    if (alreadyInMenu) {
+      guiState = WATCHFACE_STATE;
+      showWatchFace(false);
+    } else {
+      alreadyInMenu = true;
+    }
+    break;
+  }
+}
+
+// The RTCs keep local time. When the UTC time it stands for has crossed a
+// transition in settings.tzTable, move the RTC by the change in offset, so
+// DST needs no network sync.
+void Watchy::_applyTimeZone() {
+  if (settings.tzTable == NULL) {
+    return;
+  }
+  time_t utc  = makeTime(currentTime) - gmtOffset;
+  long offset = TimeZone::offsetAt(settings.tzTable, settings.tzTableSize, utc,
+                                   gmtOffset);
+  if (offset == gmtOffset) {
+    return;
+  }
+  breakTime(utc + offset, currentTime);
+  RTC.set(currentTime);
+  Alarms::shift(offset - gmtOffset);
+  gmtOffset = offset;
+}
+
 void Watchy::deepSleep() {
   display.hibernate();
   RTC.clearAlarm();        // resets the alarm flag in the RTC
+  #ifndef ARDUINO_ESP32S3_DEV
+  if (rtcTick) {
+    rtcTickTransactions = RTC.transactions() - rtcTickStart;
+  }
+  #endif
   #ifdef ARDUINO_ESP32S3_DEV
   esp_sleep_enable_ext0_wakeup((gpio_num_t)USB_DET_PIN, USB_PLUGGED_IN ? LOW : HIGH); //// enable deep sleep wake on USB plug in/out
   rtc_gpio_set_direction((gpio_num_t)USB_DET_PIN, RTC_GPIO_MODE_INPUT_ONLY);
   rtc_gpio_pullup_en((gpio_num_t)USB_DET_PIN);
 
   esp_sleep_enable_ext1_wakeup(
-      BTN_PIN_MASK,
+      (BTN_PIN_MASK) | (motionCapture ? ACC_FIFO_MASK : 0) |
+          (settings.gestureWake ? ACC_INT_MASK : 0),
       ESP_EXT1_WAKEUP_ANY_LOW); // enable deep sleep wake on button press
   rtc_gpio_set_direction((gpio_num_t)UP_BTN_PIN, RTC_GPIO_MODE_INPUT_ONLY);
   rtc_gpio_pullup_en((gpio_num_t)UP_BTN_PIN);
 
-  rtc_clk_32k_enable(true);
-  //rtc_clk_slow_freq_set(RTC_SLOW_FREQ_32K_XTAL);
-  struct tm timeinfo;
-  getLocalTime(&timeinfo);
-  int secToNextMin = 60 - timeinfo.tm_sec;
-  esp_sleep_enable_timer_wakeup(secToNextMin * uS_TO_S_FACTOR);
+  // Sub-second sleep from the calibrated system time, the minute tick is
+  // told apart from seconds and timer wakes by RTC time
+  esp_sleep_enable_timer_wakeup(RTC.sleepUs(_nextWake()));
   #else
   // Set GPIOs 0-39 to input to avoid power leaking out
   const uint64_t ignore = 0b11110001000000110000100111000010; // Ignore some GPIOs due to resets
@@ -125,13 +305,41 @@ void Watchy::deepSleep() {
   }
   esp_sleep_enable_ext0_wakeup((gpio_num_t)RTC_INT_PIN,
                                0); // enable deep sleep wake on RTC interrupt
+  uint8_t countdown = _nextWake();
+  if (countdown != rtcCountdown && RTC.setCountdown(countdown)) {
+    rtcCountdown = countdown;
+  }
+  if (countdown > 0 && rtcCountdown != countdown) {
+    // no countdown in this RTC, fall back to the ESP32 sleep timer
+    esp_sleep_enable_timer_wakeup(countdown * uS_TO_S_FACTOR);
+  }
   esp_sleep_enable_ext1_wakeup(
-      BTN_PIN_MASK,
+      (BTN_PIN_MASK) | (motionCapture ? ACC_FIFO_MASK : 0) |
+          (settings.gestureWake ? ACC_INT_MASK : 0),
       ESP_EXT1_WAKEUP_ANY_HIGH); // enable deep sleep wake on button press
   #endif
   esp_deep_sleep_start();
 }
 
+// The one wake to program besides the minute tick, in seconds from now; 0
+// for none. The minute tick redraws the face and runs the network jobs and
+// clock alarms, so only seconds wakes and timers can come before it. The
+// RTC is only read while a timer runs.
+uint8_t Watchy::_nextWake() {
+  uint8_t wake = guiState == WATCHFACE_STATE ? secondsWake : 0;
+  if (!Alarms::timing()) {
+    return wake;
+  }
+  tmElements_t tm;
+  RTC.read(tm);
+  time_t now  = makeTime(tm);
+  time_t left = max(Alarms::next(now) - now, (time_t)1); // 1 when overdue
+  if (left < 60 - tm.Second && (wake == 0 || left < wake)) {
+    wake = left;
+  }
+  return wake;
+}
+
 void Watchy::handleButtonPress() {
   uint64_t wakeupBit = esp_sleep_get_ext1_wakeup_status();
   // Menu Button
@@ -385,6 +593,17 @@ void Watchy::showAbout() {
   display.print("h");
   display.print(minutes);
   display.println("m");  
+  display.print("RTC I2C: ");
+  display.print(rtcTickTransactions);
+  display.println("/tick");
+  #else
+  display.print("32k: ");
+  if (slowClock.crystal) {
+    display.print(slowClock.calPpm);
+    display.println("ppm");
+  } else {
+    display.println("RC");
+  }
   #endif
   
   if(WIFI_CONFIGURED){
@@ -590,75 +809,117 @@ void Watchy::setTime() {
   showMenu(menuIndex, false);
 }
 
+// Light sleeps until the back button is pressed, data ready is raised (if
+// asked for) or timeoutUs passes. The display's busy callback leaves its own
+// GPIO wake enabled, so that is turned off here and the pins are released
+// again afterwards.
+static void _lightSleepUntil(uint64_t timeoutUs, bool dataReady) {
+  gpio_wakeup_disable((gpio_num_t)DISPLAY_BUSY);
+  gpio_wakeup_enable((gpio_num_t)BACK_BTN_PIN,
+                     ACTIVE_LOW ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+  if (dataReady) {
+    gpio_wakeup_enable((gpio_num_t)ACC_INT_1_PIN, ACC_INT_ACTIVE
+                                                      ? GPIO_INTR_HIGH_LEVEL
+                                                      : GPIO_INTR_LOW_LEVEL);
+  }
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup(timeoutUs);
+  esp_light_sleep_start();
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+  gpio_wakeup_disable((gpio_num_t)BACK_BTN_PIN);
+  if (dataReady) {
+    gpio_wakeup_disable((gpio_num_t)ACC_INT_1_PIN);
+  }
+}
+
+static const char *_directionName(uint8_t direction) {
+  switch (direction) {
+  case DIRECTION_DISP_DOWN:
+    return "FACE DOWN";
+  case DIRECTION_DISP_UP:
+    return "FACE UP";
+  case DIRECTION_BOTTOM_EDGE:
+    return "BOTTOM EDGE";
+  case DIRECTION_TOP_EDGE:
+    return "TOP EDGE";
+  case DIRECTION_RIGHT_EDGE:
+    return "RIGHT EDGE";
+  case DIRECTION_LEFT_EDGE:
+    return "LEFT EDGE";
+  default:
+    return "ERROR!!!";
+  }
+}
+
+// Labels are drawn once; afterwards only the value and direction windows are
+// refreshed, at most every ACCEL_VIEW_INTERVAL_MS and each time on a fresh
+// sample signalled by data ready on ACC_INT_1. The CPU light sleeps in
+// between and wakes early for the back button.
 void Watchy::showAccelerometer() {
   display.setFullWindow();
   display.fillScreen(GxEPD_BLACK);
   display.setFont(&FreeMonoBold9pt7b);
   display.setTextColor(GxEPD_WHITE);
+  display.setCursor(0, 30);
+  display.println("  X:");
+  display.println("  Y:");
+  display.println("  Z:");
+  display.display(true);
 
   Accel acc;
-
-  long previousMillis = 0;
-  long interval       = 200;
+  uint8_t shownDirection = 0xFF;
 
   guiState = APP_STATE;
 
   pinMode(BACK_BTN_PIN, INPUT);
+  pinMode(ACC_INT_1_PIN, INPUT);
+  sensor.enableIRQ(BMA4_DATA_RDY_INT);
+
+  while (digitalRead(BACK_BTN_PIN) != ACTIVE_LOW) {
+    // Wait for a sample taken after the last refresh, a silent sensor
+    // still gets its FAIL shown after the timeout
+    if (digitalRead(ACC_INT_1_PIN) != ACC_INT_ACTIVE) {
+      _lightSleepUntil(ACCEL_VIEW_INTERVAL_MS * 4000ULL, true);
+      if (digitalRead(BACK_BTN_PIN) == ACTIVE_LOW) {
+        break;
+      }
+    }
+    unsigned long refreshStart = millis();
+    bool res                   = sensor.getAccel(acc);
+    uint8_t direction          = sensor.getDirection();
+    sensor.getINT(); // releases the latched data ready
 
-  while (1) {
-
-    unsigned long currentMillis = millis();
-
-    if (digitalRead(BACK_BTN_PIN) == ACTIVE_LOW) {
-      break;
+    display.setPartialWindow(ACCEL_VIEW_VALUE_X, 12,
+                             WatchyDisplay::WIDTH - ACCEL_VIEW_VALUE_X, 60);
+    display.fillScreen(GxEPD_BLACK);
+    display.setCursor(ACCEL_VIEW_VALUE_X, 30);
+    if (res == false) {
+      display.print("FAIL");
+    } else {
+      display.print(acc.x);
+      display.setCursor(ACCEL_VIEW_VALUE_X, 48);
+      display.print(acc.y);
+      display.setCursor(ACCEL_VIEW_VALUE_X, 66);
+      display.print(acc.z);
     }
+    display.display(true);
 
-    if (currentMillis - previousMillis > interval) {
-      previousMillis = currentMillis;
-      // Get acceleration data
-      bool res          = sensor.getAccel(acc);
-      uint8_t direction = sensor.getDirection();
+    if (res && direction != shownDirection) {
+      display.setPartialWindow(0, 112, WatchyDisplay::WIDTH, 24);
       display.fillScreen(GxEPD_BLACK);
-      display.setCursor(0, 30);
-      if (res == false) {
-        display.println("getAccel FAIL");
-      } else {
-        display.print("  X:");
-        display.println(acc.x);
-        display.print("  Y:");
-        display.println(acc.y);
-        display.print("  Z:");
-        display.println(acc.z);
-
-        display.setCursor(30, 130);
-        switch (direction) {
-        case DIRECTION_DISP_DOWN:
-          display.println("FACE DOWN");
-          break;
-        case DIRECTION_DISP_UP:
-          display.println("FACE UP");
-          break;
-        case DIRECTION_BOTTOM_EDGE:
-          display.println("BOTTOM EDGE");
-          break;
-        case DIRECTION_TOP_EDGE:
-          display.println("TOP EDGE");
-          break;
-        case DIRECTION_RIGHT_EDGE:
-          display.println("RIGHT EDGE");
-          break;
-        case DIRECTION_LEFT_EDGE:
-          display.println("LEFT EDGE");
-          break;
-        default:
-          display.println("ERROR!!!");
-          break;
-        }
-      }
-      display.display(true); // full refresh
+      display.setCursor(30, 130);
+      display.print(_directionName(direction));
+      display.display(true);
+      shownDirection = direction;
+    }
+
+    unsigned long elapsed = millis() - refreshStart;
+    if (elapsed < ACCEL_VIEW_INTERVAL_MS) {
+      _lightSleepUntil((ACCEL_VIEW_INTERVAL_MS - elapsed) * 1000ULL, false);
     }
   }
 
+  sensor.disableIRQ(BMA4_DATA_RDY_INT);
   showMenu(menuIndex, false);
 }
 
@@ -667,6 +928,9 @@ void Watchy::showWatchFace(bool partialRefresh) {
   // At this point it is sure we are going to update
   display.epd2.asyncPowerOn();
   drawWatchFace();
+  if (secondsWake > 0) {
+    drawSeconds();
+  }
   display.display(partialRefresh); // partial refresh
   guiState = WATCHFACE_STATE;
 }
@@ -683,9 +947,158 @@ void Watchy::drawWatchFace() {
     display.print("0");
   }
   display.println(currentTime.Minute);
+  sleepSummary sleep;
+  if (currentTime.Hour < 12 && !Actigraphy::active() &&
+      Actigraphy::summarize(sleep)) {
+    display.setFont(&FreeMonoBold9pt7b);
+    display.setCursor(5, 150);
+    display.printf("Slept %uh%02um %u%%", sleep.asleep / 60, sleep.asleep % 60,
+                   sleep.efficiency);
+  }
+}
+
+// Wakes the watch face every 1-255 seconds to redraw just the seconds
+// window, 0 goes back to minute ticks. The PCF8563 countdown (or the sleep
+// timer on the V3 and DS3231 boards) paces the wakes, and intervals up to
+// SECONDS_LIGHT_SLEEP_MAX stay in light sleep instead.
+void Watchy::setSecondsWake(uint8_t seconds) { secondsWake = seconds; }
+
+void Watchy::secondsWindow(int16_t &x, int16_t &y, int16_t &w, int16_t &h) {
+  x = SECONDS_WINDOW_X;
+  y = SECONDS_WINDOW_Y;
+  w = SECONDS_WINDOW_W;
+  h = SECONDS_WINDOW_H;
+}
+
+// Draws the seconds into secondsWindow(), background included, so the same
+// code serves the full face and the partial refresh
+void Watchy::drawSeconds() {
+  int16_t x, y, w, h;
+  secondsWindow(x, y, w, h);
+  display.fillRect(x, y, w, h, GxEPD_WHITE);
+  display.setFont(&FreeMonoBold9pt7b);
+  display.setTextColor(GxEPD_BLACK);
+  display.setCursor(x + 2, y + h - 6);
+  display.print(":");
+  if (currentTime.Second < 10) {
+    display.print("0");
+  }
+  display.print(currentTime.Second);
+}
+
+void Watchy::showSeconds() {
+  int16_t x, y, w, h;
+  secondsWindow(x, y, w, h);
+  display.setPartialWindow(x, y, w, h);
+  drawSeconds();
+  display.display(true);
+}
+
+// Light sleep until timeoutUs passes, a button is pressed or one of the
+// accelerometer lines in accMask (ext1 bits) goes active. False for the
+// button; accPins returns the active accelerometer lines.
+static bool _lightSleepButtons(uint64_t timeoutUs, uint64_t accMask,
+                               uint64_t &accPins) {
+  static const uint8_t buttons[] = {MENU_BTN_PIN, BACK_BTN_PIN, UP_BTN_PIN,
+                                    DOWN_BTN_PIN};
+  static const uint8_t accLines[] = {ACC_INT_1_PIN, ACC_INT_2_PIN};
+  gpio_wakeup_disable((gpio_num_t)DISPLAY_BUSY);
+  for (uint8_t pin : buttons) {
+    gpio_wakeup_enable((gpio_num_t)pin, ACTIVE_LOW ? GPIO_INTR_HIGH_LEVEL
+                                                   : GPIO_INTR_LOW_LEVEL);
+  }
+  for (uint8_t pin : accLines) {
+    if (accMask & BIT64(pin)) {
+      gpio_wakeup_enable((gpio_num_t)pin, ACC_INT_ACTIVE
+                                              ? GPIO_INTR_HIGH_LEVEL
+                                              : GPIO_INTR_LOW_LEVEL);
+    }
+  }
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup(timeoutUs);
+  esp_light_sleep_start();
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+  for (uint8_t pin : buttons) {
+    gpio_wakeup_disable((gpio_num_t)pin);
+  }
+  accPins = 0;
+  for (uint8_t pin : accLines) {
+    if (accMask & BIT64(pin)) {
+      gpio_wakeup_disable((gpio_num_t)pin);
+      if (digitalRead(pin) == ACC_INT_ACTIVE) {
+        accPins |= BIT64(pin);
+      }
+    }
+  }
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER) {
+    return true;
+  }
+  for (uint8_t pin : buttons) {
+    if (digitalRead(pin) == (ACTIVE_LOW ? HIGH : LOW)) {
+      return false;
+    }
+  }
+  return accPins != 0; // anything else counts as a button, as before
+}
+
+// Short intervals cost less in light sleep than through a deep sleep wake
+// and display init. Returns on a button press, which is still held when
+// deepSleep() arms ext1 and so wakes the watch straight into the button
+// handling. The accelerometer lines deepSleep() would arm are served here
+// like the ext1 path does, so FIFOs are drained and gestures dispatched.
+void Watchy::_runSeconds() {
+  uint64_t accMask = (motionCapture ? ACC_FIFO_MASK : 0) |
+                     (settings.gestureWake ? ACC_INT_MASK : 0);
+  uint32_t next    = millis();
+  while (guiState == WATCHFACE_STATE && secondsWake > 0 &&
+         secondsWake <= SECONDS_LIGHT_SLEEP_MAX) {
+    next += _nextWake() * 1000UL; // shorter when a timer ends first
+    int32_t waitMs;
+    while ((waitMs = next - millis()) > 0) {
+      uint64_t accPins;
+      if (!_lightSleepButtons(waitMs * 1000ULL, accMask, accPins)) {
+        return;
+      }
+      if (accPins != 0) {
+        _handleAccelWake(accPins, esp_timer_get_time());
+      }
+    }
+    RTC.read(currentTime);
+    if (currentTime.Minute != tickMinute) {
+      RTC.clearAlarm(); // re-arm for the next minute
+      _minuteTick();
+    } else {
+      showSeconds();
+    }
+    _runAlarms();
+  }
 }
 
+// Rings the alarms and timers that came due by currentTime
+void Watchy::_runAlarms() {
+  uint8_t rung = Alarms::due(makeTime(currentTime));
+  for (uint8_t slot = 0; rung != 0; slot++, rung >>= 1) {
+    if (rung & 1) {
+      handleAlarm(slot);
+    }
+  }
+}
+
+// Counts down from the RTC's time, see Alarms.h for the clock alarms
+bool Watchy::startTimer(uint8_t slot, uint32_t seconds) {
+  return Alarms::startTimer(slot, seconds, _rtcNow());
+}
+
+// Buzzes for every alarm or timer that rings. Faces and apps override this
+// to show which one it was.
+void Watchy::handleAlarm(uint8_t slot) { vibMotor(); }
+
 weatherData Watchy::getWeatherData() {
+  weatherOnFace = true;
+  if (netJob != NET_JOB_NONE) {
+    // init() is already fetching in the background, draw the cached values
+    return currentWeather;
+  }
   return _getWeatherData(settings.cityID, settings.lat, settings.lon,
     settings.weatherUnit, settings.weatherLang, settings.weatherURL,
     settings.weatherAPIKey, settings.weatherUpdateInterval);
@@ -701,50 +1114,14 @@ weatherData Watchy::_getWeatherData(String cityID, String lat, String lon, Strin
   if (weatherIntervalCounter >=
       updateInterval) { // only update if WEATHER_UPDATE_INTERVAL has elapsed
                         // i.e. 30 minutes
-    if (connectWiFi()) {
-      HTTPClient http; // Use Weather API for live data if WiFi is connected
-      http.setConnectTimeout(3000); // 3 second max timeout
-      String weatherQueryURL = url;
-      if(cityID != ""){
-        weatherQueryURL.replace("{cityID}", cityID);
-      }else{
-        weatherQueryURL.replace("{lat}", lat);
-        weatherQueryURL.replace("{lon}", lon);
-      }
-      weatherQueryURL.replace("{units}", units);
-      weatherQueryURL.replace("{lang}", lang);
-      weatherQueryURL.replace("{apiKey}", apiKey);
-      http.begin(weatherQueryURL.c_str());
-      int httpResponseCode = http.GET();
-      if (httpResponseCode == 200) {
-        String payload             = http.getString();
-        JSONVar responseObject     = JSON.parse(payload);
-        currentWeather.temperature = int(responseObject["main"]["temp"]);
-        currentWeather.weatherConditionCode =
-            int(responseObject["weather"][0]["id"]);
-        currentWeather.weatherDescription =
-		        JSONVar::stringify(responseObject["weather"][0]["main"]);
-	      currentWeather.external = true;
-		        breakTime((time_t)(int)responseObject["sys"]["sunrise"], currentWeather.sunrise);
-		        breakTime((time_t)(int)responseObject["sys"]["sunset"], currentWeather.sunset);
-        // sync NTP during weather API call and use timezone of lat & lon
-        gmtOffset = int(responseObject["timezone"]);
-        syncNTP(gmtOffset);
-      } else {
-        // http error
-      }
-      http.end();
+    if (settings.bleSync && syncBLE()) {
+      // phone nearby, WiFi stays off
+    } else if (connectWiFi()) {
+      _fetchWeather(cityID, lat, lon, units, lang, url, apiKey);
       // turn off radios
-      WiFi.mode(WIFI_OFF);
-      btStop();
+      _radioOff();
     } else { // No WiFi, use internal temperature sensor
-      uint8_t temperature = sensor.readTemperature(); // celsius
-      if (!currentWeather.isMetric) {
-        temperature = temperature * 9. / 5. + 32.; // fahrenheit
-      }
-      currentWeather.temperature          = temperature;
-      currentWeather.weatherConditionCode = 800;
-      currentWeather.external             = false;
+      _internalWeather();
     }
     weatherIntervalCounter = 0;
   } else {
@@ -753,6 +1130,318 @@ weatherData Watchy::_getWeatherData(String cityID, String lat, String lon, Strin
   return currentWeather;
 }
 
+void Watchy::_fetchWeather(String cityID, String lat, String lon, String units,
+                           String lang, String url, String apiKey) {
+  String weatherQueryURL = url;
+  if(cityID != ""){
+    weatherQueryURL.replace("{cityID}", cityID);
+  }else{
+    weatherQueryURL.replace("{lat}", lat);
+    weatherQueryURL.replace("{lon}", lon);
+  }
+  weatherQueryURL.replace("{units}", units);
+  weatherQueryURL.replace("{lang}", lang);
+  weatherQueryURL.replace("{apiKey}", apiKey);
+  if (weatherQueryURL.startsWith("wxr://")) {
+    _fetchWeatherRecord(weatherQueryURL, units == String("metric"));
+    return;
+  }
+  // Connect to the cached address ourselves, HTTPClient then reuses the open
+  // connection instead of resolving the host again
+  String host;
+  uint16_t port;
+  bool secure;
+  if (!_splitURL(weatherQueryURL, host, port, secure)) {
+    networkStats.httpErrors++;
+    return;
+  }
+  WiFiClient plainClient;
+  WatchyTLSClient tlsClient;
+  tlsClient.setCACert(settings.weatherRootCA);
+  if (settings.weatherInsecureTLS) {
+    tlsClient.setInsecure();
+  }
+  WiFiClient &client = secure ? tlsClient : plainClient;
+  time_t now         = _rtcNow();
+  bool connected     = false;
+  for (uint8_t attempt = 0; attempt < 2 && !connected; attempt++) {
+    IPAddress ip;
+    if (!DNSCache::resolve(host.c_str(), ip, now)) {
+      break;
+    }
+    connected = secure ? tlsClient.connect(ip, port, host.c_str())
+                       : plainClient.connect(ip, port, 3000);
+    if (!connected) {
+      DNSCache::invalidate(host.c_str()); // maybe stale, resolve again
+    }
+  }
+  if (!connected) {
+    networkStats.httpErrors++;
+    return;
+  }
+  HTTPClient http; // Use Weather API for live data if WiFi is connected
+  http.setReuse(false); // stop the client on end(), it goes out of scope first
+  http.begin(client, weatherQueryURL);
+  networkStats.payloadSent += weatherQueryURL.length();
+  int httpResponseCode = http.GET();
+  if (httpResponseCode == 200) {
+    String payload             = http.getString();
+    networkStats.payloadReceived += payload.length();
+    int64_t parseStart         = esp_timer_get_time();
+    JSONVar responseObject     = JSON.parse(payload);
+    currentWeather.temperature = int(responseObject["main"]["temp"]);
+    currentWeather.weatherConditionCode =
+        int(responseObject["weather"][0]["id"]);
+    currentWeather.weatherDescription =
+        JSONVar::stringify(responseObject["weather"][0]["main"]);
+    currentWeather.external = true;
+    breakTime((time_t)(int)responseObject["sys"]["sunrise"], currentWeather.sunrise);
+    breakTime((time_t)(int)responseObject["sys"]["sunset"], currentWeather.sunset);
+    networkStats.parseUs = esp_timer_get_time() - parseStart;
+    // sync NTP during weather API call and use timezone of lat & lon
+    if (settings.tzTable == NULL) {
+      gmtOffset = int(responseObject["timezone"]);
+    }
+    syncNTP(gmtOffset);
+  } else {
+    // http error
+    networkStats.httpErrors++;
+  }
+  http.end();
+}
+
+void Watchy::_fetchWeatherRecord(String url, bool metric) {
+  // wxr://host:port, a single UDP exchange with a weather_proxy.py instance
+  String host;
+  uint16_t port;
+  bool secure;
+  IPAddress ip;
+  if (!_splitURL(url, host, port, secure) ||
+      !DNSCache::resolve(host.c_str(), ip, _rtcNow())) {
+    networkStats.httpErrors++;
+    return;
+  }
+  WiFiUDP udp;
+  udp.begin(49152 + (esp_random() & 0x3FFF));
+  uint8_t packet[WEATHER_RECORD_MAX_SIZE];
+  weatherRecord record;
+  bool received = false;
+  int64_t sent = 0, arrived = 0;
+  for (uint8_t attempt = 0; attempt < WEATHER_PROXY_RETRIES && !received;
+       attempt++) {
+    uint32_t nonce = esp_random();
+    size_t length  = buildWeatherRequest(packet, metric, nonce);
+    sent           = esp_timer_get_time();
+    udp.beginPacket(ip, port);
+    udp.write(packet, length);
+    if (!udp.endPacket()) {
+      continue;
+    }
+    networkStats.payloadSent += length;
+    while (esp_timer_get_time() - sent < WEATHER_PROXY_TIMEOUT_MS * 1000LL) {
+      if (udp.parsePacket() > 0) {
+        arrived = esp_timer_get_time();
+        length  = udp.read(packet, sizeof(packet));
+        networkStats.payloadReceived += length;
+        int64_t parseStart = esp_timer_get_time();
+        if (parseWeatherRecord(packet, length, record) &&
+            record.nonce == nonce) {
+          networkStats.parseUs = esp_timer_get_time() - parseStart;
+          received             = true;
+          break;
+        }
+      }
+      delay(1);
+    }
+  }
+  udp.stop();
+  if (!received) {
+    networkStats.httpErrors++;
+    return;
+  }
+  _applyWeatherRecord(record, arrived, arrived - sent);
+  if (!(record.flags & WEATHER_FLAG_TIME)) {
+    syncNTP(gmtOffset);
+  }
+}
+
+void Watchy::_applyWeatherRecord(const weatherRecord &record,
+                                 int64_t arrivedUs, int64_t roundTripUs) {
+  currentWeather.temperature          = record.temperature;
+  currentWeather.weatherConditionCode = record.weatherConditionCode;
+  currentWeather.weatherDescription   = record.description;
+  currentWeather.external             = true;
+  breakTime((time_t)record.sunrise, currentWeather.sunrise);
+  breakTime((time_t)record.sunset, currentWeather.sunset);
+  if (settings.tzTable == NULL) {
+    gmtOffset = record.timezone;
+  }
+  if (record.flags & WEATHER_FLAG_TIME) {
+    // The sender stamps its clock on the record, which saves the NTP
+    // exchange
+    int64_t senderUs = (int64_t)record.time * 1000000LL +
+                       record.timeMs * 1000LL + roundTripUs / 2;
+    _setTimeAligned(senderUs, arrivedUs, gmtOffset);
+  }
+}
+
+// Waits a few seconds for a phone or ble_sync.py to push time and weather,
+// instead of bringing up WiFi.
+bool Watchy::syncBLE() {
+  BLESync sync;
+  weatherRecord record;
+  int64_t arrived = 0;
+  if (radioOnSince == 0) {
+    radioOnSince = esp_timer_get_time();
+  }
+  bool received =
+      sync.begin(BLE_DEVICE_NAME, settings.weatherUnit == String("metric"),
+                 esp_random(), settings.blePasskey) &&
+      sync.wait(BLE_SYNC_WINDOW_MS, record, arrived);
+  sync.end();
+  _radioOff();
+  if (!received) {
+    return false;
+  }
+  currentWeather.isMetric = settings.weatherUnit == String("metric");
+  _applyWeatherRecord(record, arrived, 0);
+  BLE_CONFIGURED = true;
+  return true;
+}
+
+void Watchy::_internalWeather() {
+  uint8_t temperature = sensor.readTemperature(); // celsius
+  if (!currentWeather.isMetric) {
+    temperature = temperature * 9. / 5. + 32.; // fahrenheit
+  }
+  currentWeather.temperature          = temperature;
+  currentWeather.weatherConditionCode = 800;
+  currentWeather.external             = false;
+}
+
+// Starts associating for the network job; false when WiFi is not set up
+static bool _startWiFiJob() {
+  netJobStart = esp_timer_get_time();
+  if (WL_CONNECT_FAILED == WiFi.begin()) {
+    _radioOff();
+    return false;
+  }
+  networkStats.sessions++;
+  netJob = NET_JOB_CONNECTING;
+  return true;
+}
+
+void Watchy::_beginWeatherUpdate() {
+  // Only faces that showed the weather last time get a background fetch
+  if (!weatherOnFace ||
+      (weatherIntervalCounter >= 0 &&
+       weatherIntervalCounter < settings.weatherUpdateInterval)) {
+    return;
+  }
+  netJobStart = esp_timer_get_time();
+  if (radioOnSince == 0) {
+    radioOnSince = netJobStart;
+  }
+  if (settings.bleSync &&
+      bleSyncJob.begin(BLE_DEVICE_NAME,
+                       settings.weatherUnit == String("metric"),
+                       esp_random(), settings.blePasskey)) {
+    netJob = NET_JOB_BLE; // a phone gets BLE_SYNC_WINDOW_MS, then WiFi
+  } else if (!_startWiFiJob()) {
+    // WiFi not setup, getWeatherData() falls back to the sensor as before
+    return;
+  }
+  shownWeather = currentWeather;
+  // Poll the connection instead of light sleeping while the display is busy
+  display.epd2.setBusyCallback(_networkBusyCallback, this);
+}
+
+bool Watchy::_stepWeatherUpdate() {
+  if (netJob == NET_JOB_BLE) {
+    weatherRecord record;
+    int64_t arrived;
+    if (bleSyncJob.poll(record, arrived)) {
+      bleSyncJob.end();
+      currentWeather.isMetric = settings.weatherUnit == String("metric");
+      _applyWeatherRecord(record, arrived, 0);
+      BLE_CONFIGURED = true;
+    } else if (esp_timer_get_time() - netJobStart <
+               BLE_SYNC_WINDOW_MS * 1000LL) {
+      return false; // still advertising
+    } else {
+      bleSyncJob.end();
+      if (_startWiFiJob()) {
+        return false; // no phone came, try WiFi
+      }
+      currentWeather.isMetric = settings.weatherUnit == String("metric");
+      _internalWeather();
+    }
+    _radioOff();
+    weatherIntervalCounter = 0;
+    netJob                 = NET_JOB_DONE;
+    return true;
+  }
+  if (netJob != NET_JOB_CONNECTING) {
+    return true;
+  }
+  wl_status_t status = WiFi.status();
+  if (status == WL_CONNECTED) {
+    lastIPAddress = WiFi.localIP();
+    WiFi.SSID().toCharArray(lastSSID, 30);
+    WIFI_CONFIGURED        = true;
+    networkStats.connectMs = (esp_timer_get_time() - netJobStart) / 1000;
+    currentWeather.isMetric = settings.weatherUnit == String("metric");
+    _fetchWeather(settings.cityID, settings.lat, settings.lon,
+                  settings.weatherUnit, settings.weatherLang,
+                  settings.weatherURL, settings.weatherAPIKey);
+  } else if ((status != WL_IDLE_STATUS && status < WL_DISCONNECTED) ||
+             esp_timer_get_time() - netJobStart >
+                 WIFI_CONNECT_TIMEOUT * 1000LL) {
+    // connection failed, use internal temperature sensor
+    WIFI_CONFIGURED = false;
+    currentWeather.isMetric = settings.weatherUnit == String("metric");
+    _internalWeather();
+  } else {
+    return false; // still associating
+  }
+  // turn off radios
+  _radioOff();
+  weatherIntervalCounter = 0;
+  netJob                 = NET_JOB_DONE;
+  return true;
+}
+
+void Watchy::_finishWeatherUpdate() {
+  if (netJob == NET_JOB_NONE) {
+    return;
+  }
+  while (!_stepWeatherUpdate()) {
+    delay(10);
+  }
+  display.epd2.setBusyCallback(WatchyDisplay::busyCallback);
+  // Only refresh again if the fetch (or the NTP sync) changed what is shown
+  tmElements_t shownTime = currentTime;
+  RTC.read(currentTime);
+  if (shownWeather.temperature != currentWeather.temperature ||
+      shownWeather.weatherConditionCode !=
+          currentWeather.weatherConditionCode ||
+      shownWeather.external != currentWeather.external ||
+      shownWeather.isMetric != currentWeather.isMetric ||
+      shownTime.Minute != currentTime.Minute ||
+      shownTime.Hour != currentTime.Hour) {
+    showWatchFace(true);
+  }
+  netJob = NET_JOB_NONE;
+}
+
+void Watchy::_networkBusyCallback(const void *watchy) {
+  if (((Watchy *)watchy)->_stepWeatherUpdate()) {
+    WatchyDisplay::busyCallback(watchy); // nothing left to do, light sleep
+  } else {
+    delay(1);
+  }
+}
+
 float Watchy::getBatteryVoltage() {
   #ifdef ARDUINO_ESP32S3_DEV
     return analogReadMilliVolts(BATT_ADC_PIN) / 1000.0f * ADC_VOLTAGE_DIVIDER;
@@ -766,17 +1455,230 @@ float Watchy::getBatteryVoltage() {
   #endif
 }
 
+// Rough LiPo state of charge from the resting voltage
+uint8_t Watchy::getBatteryPercent() {
+  static const uint16_t mV[]     = {3300, 3500, 3600, 3650, 3700, 3750,
+                                    3800, 3900, 4000, 4100, 4200};
+  static const uint8_t percent[] = {0, 5, 12, 20, 30, 40, 50, 65, 78, 90, 100};
+  uint16_t voltage               = getBatteryVoltage() * 1000;
+  if (voltage <= mV[0]) {
+    return 0;
+  }
+  for (uint8_t i = 1; i < sizeof(mV) / sizeof(mV[0]); i++) {
+    if (voltage < mV[i]) {
+      return percent[i - 1] + (percent[i] - percent[i - 1]) *
+                                  (voltage - mV[i - 1]) / (mV[i] - mV[i - 1]);
+    }
+  }
+  return 100;
+}
+
+// Advertises battery, steps, sync age and firmware version for a moment,
+// no connection needed to collect them
+bool Watchy::broadcastTelemetry() {
+  beaconData data;
+  time_t now    = makeTime(currentTime);
+  data.battery  = getBatteryPercent();
+  data.steps    = sensor.getCounter();
+  data.syncAge  = 0xFFFF;
+  data.sequence = beaconSequence++;
+  if (lastTimeSync != 0) {
+    data.syncAge = min((time_t)0xFFFE, (now - lastTimeSync) / SECS_PER_MIN);
+  }
+  lastBeacon = now;
+  return BLEBeacon::broadcast(data, BLE_BEACON_DURATION_MS);
+}
+
+// Samples from the BMA423 FIFO are collected in deep sleep at the configured
+// ODR / 2^downsampling, and the watermark wakes the watch once
+// watermarkFrames are waiting, on ACC_INT_2 on the V3 and on ACC_INT_1 on
+// earlier boards (see ACC_FIFO_MASK). Each wake drains the FIFO into
+// handleMotionSamples().
+bool Watchy::startMotionCapture(uint16_t watermarkFrames,
+                                uint8_t downsampling) {
+  if (!watchyHardware.bmaConfigured) {
+    return false;
+  }
+  struct bma4_int_pin_config config;
+  config.edge_ctrl = BMA4_LEVEL_TRIGGER;
+  config.lvl       = ACC_INT_ACTIVE ? BMA4_ACTIVE_HIGH : BMA4_ACTIVE_LOW;
+  config.od        = BMA4_PUSH_PULL;
+  #ifdef ARDUINO_ESP32S3_DEV
+  config.output_en = BMA4_OUTPUT_ENABLE;
+  #else
+  config.output_en = BMA4_OUTPUT_DISABLE; // GPIO12 stays on its pull-down
+  #endif
+  config.input_en  = BMA4_INPUT_DISABLE;
+  if (!sensor.setINTPinConfig(config, BMA4_INTR2_MAP)) {
+    return false;
+  }
+  if (!sensor.enableFIFO(watermarkFrames, downsampling, ACC_FIFO_MAP)) {
+    return false;
+  }
+  motionCapture = true;
+  return true;
+}
+
+void Watchy::stopMotionCapture() {
+  sensor.disableFIFO(ACC_FIFO_MAP);
+  motionCapture = false;
+}
+
+void Watchy::handleMotionSamples(const Accel *samples, uint16_t count) {}
+
+// Drops the BMA423 to ACTIGRAPHY_ODR in averaging mode and wakes every
+// ACTIGRAPHY_WATERMARK frames to fold them into one-minute epochs. The step
+// counter needs 50 Hz and stands still until stopSleepTracking().
+bool Watchy::startSleepTracking() {
+  if (Actigraphy::active()) {
+    return true;
+  }
+  if (motionCapture) {
+    return false; // the FIFO is taken, keep the config saved for it
+  }
+  Acfg cfg;
+  if (!sensor.getAccelConfig(trackingSavedCfg)) {
+    return false;
+  }
+  cfg           = trackingSavedCfg;
+  cfg.odr       = ACTIGRAPHY_ODR;
+  cfg.bandwidth = BMA4_ACCEL_NORMAL_AVG4;
+  cfg.perf_mode = BMA4_CIC_AVG_MODE;
+  if (!sensor.setAccelConfig(cfg) ||
+      !startMotionCapture(ACTIGRAPHY_WATERMARK)) {
+    sensor.setAccelConfig(trackingSavedCfg);
+    return false;
+  }
+  Actigraphy::begin(makeTime(currentTime));
+  return true;
+}
+
+void Watchy::stopSleepTracking() {
+  if (!Actigraphy::active()) {
+    return;
+  }
+  sensor.readFIFO(_motionCallback, this); // the last partial watermark
+  stopMotionCapture();
+  sensor.setAccelConfig(trackingSavedCfg);
+  Actigraphy::end();
+}
+
+// Called on every RTC tick, so a missed minute at either end of the window
+// only delays the start or stop by one tick
+void Watchy::_updateSleepTracking() {
+  bool night = currentTime.Hour >= ACTIGRAPHY_START_HOUR ||
+               currentTime.Hour < ACTIGRAPHY_END_HOUR;
+  if (settings.sleepTracking && night) {
+    startSleepTracking();
+  } else {
+    stopSleepTracking();
+  }
+}
+
+// Double tap refreshes the face, cheaper than a button wake and a trip
+// through the menu. Faces and apps override this for their own actions.
+void Watchy::handleGesture(uint8_t gestures) {
+  if (guiState == WATCHFACE_STATE && (gestures & GESTURE_DOUBLE_TAP)) {
+    showWatchFace(true);
+  }
+}
+
+// Serves the accelerometer lines that woke the watch. INT_LATCH holds both
+// pins, and reading the interrupt status releases both, so it is read once
+// per pass and everything it holds is served from that one read: gestures,
+// then the FIFO. Draining can latch a new watermark, so the lines are
+// checked again afterwards.
+void Watchy::_handleAccelWake(uint64_t lines, int64_t wokeUs) {
+  if (lines & ACC_INT_MASK) {
+    gestureLatency.wakes++;
+  }
+  pinMode(ACC_INT_1_PIN, INPUT);
+  #ifdef ARDUINO_ESP32S3_DEV
+  pinMode(ACC_INT_2_PIN, INPUT);
+  #endif
+  for (uint8_t pass = 0; pass < 3 && lines != 0; pass++) {
+    if (!sensor.getINT()) {
+      return;
+    }
+    _handleGestures(wokeUs);
+    if (motionCapture &&
+        (sensor.isFIFOWatermark() || (lines & ACC_FIFO_MASK))) {
+      sensor.readFIFO(_motionCallback, this);
+    }
+    lines = 0;
+    if (digitalRead(ACC_INT_1_PIN) == ACC_INT_ACTIVE) {
+      lines |= ACC_INT_MASK;
+    }
+    #ifdef ARDUINO_ESP32S3_DEV
+    if (digitalRead(ACC_INT_2_PIN) == ACC_INT_ACTIVE) {
+      lines |= ACC_INT_2_MASK;
+    }
+    #endif
+  }
+}
+
+// Dispatches the gestures in the status _handleAccelWake() read. Latency
+// runs from wokeUs, app start for deep sleep wakes (the ROM and bootloader
+// before it are not counted), to the handler's return.
+void Watchy::_handleGestures(int64_t wokeUs) {
+  uint8_t gestures = 0;
+  if (sensor.isDoubleClick()) {
+    gestures |= GESTURE_DOUBLE_TAP;
+  }
+  if (sensor.isTilt()) {
+    gestures |= GESTURE_TILT;
+  }
+  if (gestures == 0) {
+    return; // step counter or another feature sharing ACC_INT_1
+  }
+  RTC.read(currentTime);
+  handleGesture(gestures);
+  uint32_t latencyUs = esp_timer_get_time() - wokeUs;
+  gestureLatency.dispatched++;
+  gestureLatency.lastLatencyUs = latencyUs;
+  gestureLatency.maxLatencyUs  = max(gestureLatency.maxLatencyUs, latencyUs);
+  gestureLatency.totalLatencyUs += latencyUs;
+}
+
+void Watchy::_motionCallback(void *watchy, const Accel *samples,
+                             uint16_t count) {
+  if (Actigraphy::active()) {
+    for (uint16_t i = 0; i < count; i++) {
+      Actigraphy::addSample(samples[i].x, samples[i].y, samples[i].z);
+    }
+  }
+  ((Watchy *)watchy)->handleMotionSamples(samples, count);
+}
+
 uint8_t Watchy::getBoardRevision() {
+  if (HardwareInfo::valid()) {
+    return watchyHardware.boardRevision;
+  }
+  return _probeBoardRevision();
+}
+
+// Probes everything HardwareInfo caches; only runs when the record is
+// missing, every other wake reads it from RTC memory
+void Watchy::_probeHardware() {
+  uint8_t rtcType = 0;
+  #ifndef ARDUINO_ESP32S3_DEV
+  if (RTC.init()) {
+    rtcType = RTC.rtcType;
+  }
+  #endif
+  HardwareInfo::record(_probeBoardRevision(), rtcType,
+                       WatchyI2C::probe(BMA4_I2C_ADDR_PRIMARY));
+}
+
+uint8_t Watchy::_probeBoardRevision() {
   esp_chip_info_t chip_info;
   esp_chip_info(&chip_info);
   if(chip_info.model == CHIP_ESP32){ //Revision 1.0 - 2.0
-    Wire.beginTransmission(0x68); //v1.0 has DS3231
-    if (Wire.endTransmission() == 0){
+    if (WatchyI2C::probe(0x68)){ //v1.0 has DS3231
       return 10;
     }
     delay(1);
-    Wire.beginTransmission(0x51); //v1.5 and v2.0 have PCF8563
-    if (Wire.endTransmission() == 0){
+    if (WatchyI2C::probe(0x51)){ //v1.5 and v2.0 have PCF8563
         pinMode(35, INPUT);
         if(digitalRead(35) == 0){
           return 20; //in rev 2.0, pin 35 is BTN 3 and has a pulldown
@@ -793,28 +1695,19 @@ uint8_t Watchy::getBoardRevision() {
 
 uint16_t Watchy::_readRegister(uint8_t address, uint8_t reg, uint8_t *data,
                                uint16_t len) {
-  Wire.beginTransmission(address);
-  Wire.write(reg);
-  Wire.endTransmission();
-  Wire.requestFrom((uint8_t)address, (uint8_t)len);
-  uint8_t i = 0;
-  while (Wire.available()) {
-    data[i++] = Wire.read();
-  }
-  return 0;
+  // The FIFO data register does not auto-increment
+  return WatchyI2C::read(address, reg, data, len, reg != BMA4_FIFO_DATA_ADDR);
 }
 
 uint16_t Watchy::_writeRegister(uint8_t address, uint8_t reg, uint8_t *data,
                                 uint16_t len) {
-  Wire.beginTransmission(address);
-  Wire.write(reg);
-  Wire.write(data, len);
-  return (0 != Wire.endTransmission());
+  return WatchyI2C::write(address, reg, data, len);
 }
 
 void Watchy::_bmaConfig() {
 
-  if (sensor.begin(_readRegister, _writeRegister, delay) == false) {
+  if (!watchyHardware.bmaPresent ||
+      sensor.begin(_readRegister, _writeRegister, delay) == false) {
     // fail to init BMA
     return;
   }
@@ -874,12 +1767,16 @@ void Watchy::_bmaConfig() {
 
   struct bma4_int_pin_config config;
   config.edge_ctrl = BMA4_LEVEL_TRIGGER;
-  config.lvl       = BMA4_ACTIVE_HIGH;
+  config.lvl       = ACC_INT_ACTIVE ? BMA4_ACTIVE_HIGH : BMA4_ACTIVE_LOW;
   config.od        = BMA4_PUSH_PULL;
   config.output_en = BMA4_OUTPUT_ENABLE;
   config.input_en  = BMA4_INPUT_DISABLE;
   // The correct trigger interrupt needs to be configured as needed
   sensor.setINTPinConfig(config, BMA4_INTR1_MAP);
+  // Hold gesture interrupts until the status is read, so the deep sleep
+  // wake sees them however short the feature pulse is. This covers the FIFO
+  // watermark as well, _handleAccelWake() releases both lines.
+  sensor.setLatched(true);
 
   struct bma423_axes_remap remap_data;
   remap_data.x_axis      = 1;
@@ -906,6 +1803,7 @@ void Watchy::_bmaConfig() {
   sensor.enableTiltInterrupt();
   // It corresponds to isDoubleClick interrupt
   sensor.enableWakeupInterrupt();
+  watchyHardware.bmaConfigured = true;
 }
 
 void Watchy::setupWifi() {
@@ -932,8 +1830,7 @@ void Watchy::setupWifi() {
   }
   display.display(false); // full refresh
   // turn off radios
-  WiFi.mode(WIFI_OFF);
-  btStop();
+  _radioOff();
   // enable lightsleep on busy
   display.epd2.setBusyCallback(WatchyDisplay::busyCallback);
   guiState = APP_STATE;
@@ -956,21 +1853,27 @@ void Watchy::_configModeCallback(WiFiManager *myWiFiManager) {
 }
 
 bool Watchy::connectWiFi() {
+  int64_t start = esp_timer_get_time();
+  if (radioOnSince == 0) {
+    radioOnSince = start;
+  }
+  networkStats.sessions++;
   if (WL_CONNECT_FAILED ==
       WiFi.begin()) { // WiFi not setup, you can also use hard coded credentials
                       // with WiFi.begin(SSID,PASS);
     WIFI_CONFIGURED = false;
+    _radioOff();
   } else {
     if (WL_CONNECTED ==
         WiFi.waitForConnectResult()) { // attempt to connect for 10s
       lastIPAddress = WiFi.localIP();
       WiFi.SSID().toCharArray(lastSSID, 30);
       WIFI_CONFIGURED = true;
+      networkStats.connectMs = (esp_timer_get_time() - start) / 1000;
     } else { // connection failed, time out
       WIFI_CONFIGURED = false;
       // turn off radios
-      WiFi.mode(WIFI_OFF);
-      btStop();
+      _radioOff();
     }
   }
   return WIFI_CONFIGURED;
@@ -1118,8 +2021,7 @@ void Watchy::showSyncNTP() {
     } else {
       display.println("NTP Sync Failed");
     }
-    WiFi.mode(WIFI_OFF);
-    btStop();
+    _radioOff();
   } else {
     display.println("WiFi Not Configured");
   }
@@ -1141,14 +2043,135 @@ bool Watchy::syncNTP(long gmt) {
 bool Watchy::syncNTP(long gmt, String ntpServer) {
   // NTP sync - call after connecting to
   // WiFi and remember to turn it back off
+  // ntpServer may carry a port, e.g. "192.168.1.10:1123"
+  uint16_t port = 123;
+  int colon     = ntpServer.indexOf(':');
+  if (colon >= 0) {
+    port      = ntpServer.substring(colon + 1).toInt();
+    ntpServer = ntpServer.substring(0, colon);
+  }
+  IPAddress server;
+  if (!DNSCache::resolve(ntpServer.c_str(), server, _rtcNow())) {
+    return false; // DNS lookup failed
+  }
   WiFiUDP ntpUDP;
-  NTPClient timeClient(ntpUDP, ntpServer.c_str(), gmt);
-  timeClient.begin();
-  if (!timeClient.forceUpdate()) {
+  ntpUDP.begin(NTP_LOCAL_PORT);
+  // Keep the sample with the shortest round trip, its delay correction is the
+  // most trustworthy one
+  bool synced        = false;
+  int64_t bestServer = 0, bestLocal = 0, bestDelay = 0;
+  for (uint8_t i = 0; i < NTP_SYNC_SAMPLES; i++) {
+    int64_t serverUs, localUs, delayUs;
+    networkStats.ntpSamples++;
+    if (!_ntpSample(ntpUDP, server, port, esp_random(), serverUs, localUs,
+                    delayUs)) {
+      networkStats.ntpFailures++;
+    } else if (!synced || delayUs < bestDelay) {
+      bestServer = serverUs;
+      bestLocal  = localUs;
+      bestDelay  = delayUs;
+      synced     = true;
+    }
+  }
+  ntpUDP.stop();
+  if (!synced) {
     return false; // NTP sync failed
   }
+  networkStats.ntpDelayUs = bestDelay;
+  _setTimeAligned(bestServer, bestLocal, gmt);
+  return true;
+}
+
+void Watchy::_setTimeAligned(int64_t serverUs, int64_t localUs, long gmt) {
+  if (settings.tzTable != NULL) {
+    // the table, not the caller's fixed offset, decides at the server's time
+    gmtOffset = TimeZone::offsetAt(settings.tzTable, settings.tzTableSize,
+                                   serverUs / 1000000LL, gmt);
+    gmt       = gmtOffset;
+  }
+  // The RTCs only hold whole seconds and restart their second when written,
+  // so wait for the next second boundary before setting them
+  int64_t nowUs = serverUs + (esp_timer_get_time() - localUs) +
+                  (int64_t)gmt * 1000000LL;
+  int64_t waitUs   = 1000000LL - (nowUs % 1000000LL);
+  int64_t deadline = esp_timer_get_time() + waitUs;
+  if (waitUs > 2000) {
+    delay((waitUs - 2000) / 1000);
+  }
+  while (esp_timer_get_time() < deadline) {
+  }
   tmElements_t tm;
-  breakTime((time_t)timeClient.getEpochTime(), tm);
+  lastTimeSync = (time_t)((nowUs + waitUs) / 1000000LL);
+  if (Alarms::timing()) {
+    Alarms::shift(lastTimeSync - _rtcNow());
+  }
+  breakTime(lastTimeSync, tm);
+  #ifdef ARDUINO_ESP32S3_DEV
+  RTC.syncTo(lastTimeSync);
+  #endif
   RTC.set(tm);
+}
+
+// Converts a 64 bit NTP timestamp to microseconds since the Unix epoch
+static int64_t _ntpToUnixUs(const uint8_t *p) {
+  uint32_t sec  = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                 ((uint32_t)p[2] << 8) | p[3];
+  uint32_t frac = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) |
+                  ((uint32_t)p[6] << 8) | p[7];
+  int64_t seconds = sec;
+  if (sec < 0x80000000UL) {
+    seconds += 0x100000000LL; // era 1, after February 2036
+  }
+  return (seconds - 2208988800LL) * 1000000LL +
+         (int64_t)(((uint64_t)frac * 1000000ULL) >> 32);
+}
+
+bool Watchy::_ntpSample(WiFiUDP &udp, IPAddress server, uint16_t port,
+                        uint32_t nonce,
+                        int64_t &serverUs, int64_t &localUs,
+                        int64_t &delayUs) {
+  uint8_t packet[48];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = 0x23; // LI 0, version 4, client mode
+  // The server echoes our transmit timestamp back as the originate timestamp,
+  // which lets us drop late replies to an earlier request
+  memcpy(&packet[40], &nonce, sizeof(nonce));
+  while (udp.parsePacket() > 0) {
+    udp.flush(); // drop stale replies
+  }
+  int64_t t1 = esp_timer_get_time();
+  udp.beginPacket(server, port);
+  udp.write(packet, sizeof(packet));
+  if (!udp.endPacket()) {
+    return false;
+  }
+  networkStats.payloadSent += sizeof(packet);
+  while (true) {
+    if (udp.parsePacket() >= (int)sizeof(packet)) {
+      localUs = esp_timer_get_time();
+      break;
+    }
+    if (esp_timer_get_time() - t1 > NTP_TIMEOUT_MS * 1000LL) {
+      return false; // timed out
+    }
+    delay(1);
+  }
+  udp.read(packet, sizeof(packet));
+  networkStats.payloadReceived += sizeof(packet);
+  uint8_t leap    = packet[0] >> 6;
+  uint8_t mode    = packet[0] & 0x07;
+  uint8_t stratum = packet[1];
+  if (leap == 3 || mode != 4 || stratum == 0 || stratum > 15 ||
+      memcmp(&packet[24], &nonce, sizeof(nonce)) != 0) {
+    return false; // unsynchronised server, kiss-o'-death or stray packet
+  }
+  int64_t t2 = _ntpToUnixUs(&packet[32]); // server receive
+  int64_t t3 = _ntpToUnixUs(&packet[40]); // server transmit
+  delayUs    = (localUs - t1) - (t3 - t2);
+  if (delayUs < 0) {
+    delayUs = 0;
+  }
+  // Assume a symmetric path, the reply spent half the round trip in flight
+  serverUs = t3 + delayUs / 2;
   return true;
 }
@@ -11,11 +11,23 @@
 #include <Wire.h>
 #include <Fonts/FreeMonoBold9pt7b.h>
 #include "DSEG7_Classic_Bold_53.h"
+#include "Actigraphy.h"
+#include "Alarms.h"
 #include "Display.h"
 #include "BLE.h"
+#include "BLEBeacon.h"
+#include "BLESync.h"
+#include "DNSCache.h"
+#include "HardwareInfo.h"
+#include "StepHistory.h"
+#include "TLSClient.h"
+#include "TimeZone.h"
+#include "WatchyI2C.h"
+#include "WeatherRecord.h"
 #include "bma.h"
 #include "config.h"
 #include "esp_chip_info.h"
+#include "esp_timer.h"
 #ifdef ARDUINO_ESP32S3_DEV
   #include "Watchy32KRTC.h"
   #include "soc/rtc.h"
@@ -29,11 +41,11 @@
   #include "esp_sntp.h"
   #include "hal/rtc_io_types.h"
   #include "driver/rtc_io.h"
-  #define uS_TO_S_FACTOR 1000000ULL  //Conversion factor for micro seconds to seconds
   #define ADC_VOLTAGE_DIVIDER ((360.0f+100.0f)/360.0f) //Voltage divider at battery ADC  
 #else
   #include "WatchyRTC.h"
 #endif
+#define uS_TO_S_FACTOR 1000000ULL  //Conversion factor for micro seconds to seconds
 
 typedef struct weatherData {
   int8_t temperature;
@@ -45,6 +57,28 @@ typedef struct weatherData {
   tmElements_t sunset;
 } weatherData;
 
+typedef struct netStats {
+  uint32_t sessions;        // WiFi connection attempts
+  uint32_t connectMs;       // association + DHCP time of the last attempt
+  uint32_t radioOnMs;       // total time the radio was on
+  // Application payload only, HTTP headers, DNS and TLS are not counted
+  uint32_t payloadSent;     // HTTP request lines, proxy and NTP requests
+  uint32_t payloadReceived; // HTTP bodies, proxy records and NTP replies
+  uint32_t parseUs;         // weather response parse time of the last fetch
+  uint32_t httpErrors;
+  uint32_t ntpSamples;
+  uint32_t ntpFailures;
+  int32_t ntpDelayUs;       // round trip of the sample used by the last sync
+} netStats;
+
+typedef struct gestureStats {
+  uint32_t wakes;      // ACC_INT_1 wakes
+  uint32_t dispatched; // wakes that carried a gesture
+  uint32_t lastLatencyUs;
+  uint32_t maxLatencyUs;
+  uint64_t totalLatencyUs; // divide by dispatched for the mean
+} gestureStats;
+
 typedef struct watchySettings {
   // Weather Settings
   String cityID;
@@ -60,6 +94,27 @@ typedef struct watchySettings {
   int gmtOffset;
   //
   bool vibrateOClock;
+  // Root CA for https weather URLs, required unless weatherInsecureTLS
+  const char *weatherRootCA;
+  // Try a BLE push from a phone before WiFi when the weather is due, needs
+  // blePasskey
+  bool bleSync;
+  // Minutes between telemetry broadcasts (BLEBeacon), 0 disables them
+  uint16_t beaconInterval;
+  // Wake from deep sleep on double tap / tilt and call handleGesture()
+  bool gestureWake;
+  // Record actigraphy between ACTIGRAPHY_START_HOUR and ACTIGRAPHY_END_HOUR
+  bool sleepTracking;
+  // DST and offset changes from extras/tools/tz_table.py, NULL keeps the
+  // fixed gmtOffset (updated by weather responses)
+  const tzTransition *tzTable;
+  uint16_t tzTableSize;
+  // INSECURE: https weather URLs without weatherRootCA accept any
+  // certificate, so anyone on the path can forge the weather and time
+  bool weatherInsecureTLS;
+  // 6 digit passkey a phone pairs with once for bleSync, 0 leaves the BLE
+  // sync off; records are only taken over the encrypted, bonded link
+  uint32_t blePasskey;
 } watchySettings;
 
 class Watchy {
@@ -78,6 +133,7 @@ public:
   void init(String datetime = "");
   void deepSleep();
   float getBatteryVoltage();
+  uint8_t getBatteryPercent();
   uint8_t getBoardRevision();
   void vibMotor(uint8_t intervalMs = 100, uint8_t length = 20);
 
@@ -92,6 +148,17 @@ public:
   bool syncNTP();
   bool syncNTP(long gmt);
   bool syncNTP(long gmt, String ntpServer);
+  bool syncBLE();
+  bool broadcastTelemetry();
+  bool startMotionCapture(uint16_t watermarkFrames, uint8_t downsampling = 0);
+  void stopMotionCapture();
+  bool startSleepTracking();
+  void stopSleepTracking();
+  virtual void handleMotionSamples(const Accel *samples,
+                                   uint16_t count); // override to log motion
+  virtual void handleGesture(uint8_t gestures); // GESTURE_* bits
+  bool startTimer(uint8_t slot, uint32_t seconds);
+  virtual void handleAlarm(uint8_t slot); // an Alarms slot rang
   void setTime();
   void setupWifi();
   bool connectWiFi();
@@ -101,16 +168,47 @@ public:
   void showWatchFace(bool partialRefresh);
   virtual void drawWatchFace(); // override this method for different watch
                                 // faces
+  void setSecondsWake(uint8_t seconds);
+  void showSeconds();
+  virtual void drawSeconds(); // override to style the seconds
+  virtual void secondsWindow(int16_t &x, int16_t &y, int16_t &w,
+                             int16_t &h); // x must be a multiple of 8
 
 private:
   void _bmaConfig();
+  void _probeHardware();
+  static uint8_t _probeBoardRevision();
+  void _handleAccelWake(uint64_t lines, int64_t wokeUs = 0);
+  void _handleGestures(int64_t wokeUs);
+  void _minuteTick();
+  void _applyTimeZone();
+  void _runSeconds();
+  void _runAlarms();
+  uint8_t _nextWake();
+  void _updateSleepTracking();
   static void _configModeCallback(WiFiManager *myWiFiManager);
   static uint16_t _readRegister(uint8_t address, uint8_t reg, uint8_t *data,
                                 uint16_t len);
   static uint16_t _writeRegister(uint8_t address, uint8_t reg, uint8_t *data,
                                  uint16_t len);
   weatherData _getWeatherData(String cityID, String lat, String lon, String units, String lang,
-                             String url, String apiKey, uint8_t updateInterval);                                 
+                             String url, String apiKey, uint8_t updateInterval);
+  void _fetchWeather(String cityID, String lat, String lon, String units,
+                     String lang, String url, String apiKey);
+  void _fetchWeatherRecord(String url, bool metric);
+  void _applyWeatherRecord(const weatherRecord &record, int64_t arrivedUs,
+                           int64_t roundTripUs);
+  void _internalWeather();
+  void _setTimeAligned(int64_t serverUs, int64_t localUs, long gmt);
+  void _beginWeatherUpdate();
+  bool _stepWeatherUpdate();
+  void _finishWeatherUpdate();
+  static void _networkBusyCallback(const void *watchy);
+  static void _motionCallback(void *watchy, const Accel *samples,
+                              uint16_t count);
+  static bool _ntpSample(WiFiUDP &udp, IPAddress server, uint16_t port,
+                         uint32_t nonce,
+                         int64_t &serverUs, int64_t &localUs, int64_t &delayUs);
 };
 
 extern RTC_DATA_ATTR int guiState;
@@ -119,5 +217,8 @@ extern RTC_DATA_ATTR BMA423 sensor;
 extern RTC_DATA_ATTR bool WIFI_CONFIGURED;
 extern RTC_DATA_ATTR bool BLE_CONFIGURED;
 extern RTC_DATA_ATTR bool USB_PLUGGED_IN;
+extern RTC_DATA_ATTR netStats networkStats;
+extern RTC_DATA_ATTR gestureStats gestureLatency;
+extern RTC_DATA_ATTR uint16_t rtcTickTransactions;
 
 #endif
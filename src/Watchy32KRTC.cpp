@@ -1,9 +1,120 @@
 #include "Watchy32KRTC.h"
+#include "esp_private/esp_clk.h"
+#include "soc/rtc.h"
+#include <sys/time.h>
+
+#define SLOW_CLK_NOMINAL_PERIOD ((1000000ULL << 19) / 32768) // Q19 microseconds
+
+RTC_DATA_ATTR slowClockStats slowClock;
+RTC_DATA_ATTR uint8_t calCountdown = 0; // minute ticks to the next calibration
+static bool crystalChecked = false;     // init() ran since this boot
 
 Watchy32KRTC::Watchy32KRTC(){}
 
+// The crystal keeps running through deep sleep, but esp_clk_init() selects
+// the sdkconfig slow clock on every boot. A crystal found at cold boot is
+// selected and calibrated again on each wake; a missing one is only looked
+// for once, its start attempts take a second.
 void Watchy32KRTC::init() {
+  if (crystalChecked) {
+    return;
+  }
+  crystalChecked = true;
+  if (slowClock.crystal) {
+    _startCrystal(1);
+  } else if (!slowClock.started) {
+    slowClock.started = true;
+    _startCrystal(SLOW_CLK_START_ATTEMPTS);
+  }
+}
+
+// Same steps as the bootloader's CONFIG_RTC_CLK_SRC_EXT_CRYS: a crystal that
+// has not started makes rtc_clk_cal() time out with 0, and the RC oscillator
+// stays in use until the next cold boot. The measured period is the
+// calibration of the crystal once it is selected.
+void Watchy32KRTC::_startCrystal(uint8_t attempts) {
+  rtc_clk_32k_enable(true);
+  for (uint8_t attempt = 0; attempt < attempts; attempt++) {
+    if (attempt > 0) {
+      delay(100);
+    }
+    uint32_t period = rtc_clk_cal(RTC_CAL_32K_XTAL, SLOW_CLK_CAL_CYCLES);
+    if (period != 0) {
+      rtc_clk_slow_freq_set(RTC_SLOW_FREQ_32K_XTAL);
+      slowClock.crystal = true;
+      _setPeriod(period);
+      return;
+    }
+  }
+  slowClock.crystal = false;
+  rtc_clk_32k_enable(false);
+}
+
+// Measures the slow clock against the XTAL and hands the period to the
+// system time, which keeps its value continuous across the change
+void Watchy32KRTC::_calibrate() {
+  uint32_t period = rtc_clk_cal(RTC_CAL_RTC_MUX, SLOW_CLK_CAL_CYCLES);
+  if (period != 0) {
+    _setPeriod(period);
+  }
+}
+
+void Watchy32KRTC::_setPeriod(uint32_t period) {
+  esp_clk_slowclk_cal_set(period);
+  slowClock.calibrations++;
+  slowClock.period = period;
+  // A shorter period is a faster crystal
+  slowClock.calPpm = ((int64_t)SLOW_CLK_NOMINAL_PERIOD - period) * 1000000LL /
+                     (int64_t)period;
+  calCountdown     = SLOW_CLK_CAL_INTERVAL;
+}
+
+// Called first on each timer wake. A wake that came up to
+// SLOW_CLK_EARLY_MAX_US before the minute waits for it here instead of
+// sleeping again, then the lateness of the tick is recorded.
+void Watchy32KRTC::tick() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  uint64_t untilMinute =
+      (60 - now.tv_sec % 60) * 1000000ULL - now.tv_usec;
+  if (untilMinute <= SLOW_CLK_EARLY_MAX_US) {
+    slowClock.earlyTicks++;
+    delayMicroseconds(untilMinute);
+    gettimeofday(&now, NULL);
+  }
+  if (now.tv_sec % 60 == 0) {
+    slowClock.ticks++;
+    slowClock.lastLateUs = now.tv_usec;
+    slowClock.maxLateUs  = max(slowClock.maxLateUs, slowClock.lastLateUs);
+    if (slowClock.crystal && --calCountdown == 0) {
+      _calibrate();
+    }
+  }
+}
+
+// Time to sleep until just past the next minute, or the next whole second
+// seconds from now when that comes first
+uint64_t Watchy32KRTC::sleepUs(uint8_t seconds) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  uint64_t toSecond = 1000000ULL - now.tv_usec;
+  uint64_t sleep    = (59 - now.tv_sec % 60) * 1000000ULL + toSecond;
+  if (seconds > 0) {
+    sleep = min(sleep, (seconds - 1) * 1000000ULL + toSecond);
+  }
+  return sleep + SLOW_CLK_TICK_GUARD_US;
+}
 
+// Compares the clock with the network time it is about to be set to
+void Watchy32KRTC::syncTo(time_t now) {
+  struct timeval clock;
+  gettimeofday(&clock, NULL);
+  int64_t errorUs = ((int64_t)clock.tv_sec - now) * 1000000LL + clock.tv_usec;
+  slowClock.syncErrorMs = errorUs / 1000;
+  if (slowClock.lastSync != 0 && now > slowClock.lastSync) {
+    slowClock.driftPpm = errorUs / (now - slowClock.lastSync);
+  }
+  slowClock.lastSync = now;
 }
 
 /*
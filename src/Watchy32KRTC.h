@@ -5,10 +5,33 @@
 #include <TimeLib.h>
 #include "config.h"
 
+// The V3 keeps time in the ESP32-S3 RTC timer. It runs from the 32 kHz
+// crystal, calibrated against the 40 MHz XTAL every SLOW_CLK_CAL_INTERVAL
+// minutes, instead of the internal RC oscillator. Every boot, deep sleep
+// wakes included, selects the RC oscillator again, so init() selects the
+// crystal anew on each one.
+typedef struct slowClockStats {
+  bool started;          // crystal start tried since the last cold boot
+  bool crystal;          // slow clock runs from the crystal
+  uint32_t calibrations;
+  uint32_t period;       // last calibration, microseconds << 19 per cycle
+  int16_t calPpm;        // crystal frequency above 32768 Hz
+  int32_t syncErrorMs;   // clock minus network time at the last sync
+  int32_t driftPpm;      // clock gain per second between the last two syncs
+  time_t lastSync;       // 0 before the first sync
+  uint32_t ticks;
+  uint32_t earlyTicks;   // woke before the minute and waited it out
+  uint32_t lastLateUs;   // how far past the minute the last tick read the time
+  uint32_t maxLateUs;
+} slowClockStats;
+
 class Watchy32KRTC {
 public:
   Watchy32KRTC();
   void init();
+  void tick();
+  void syncTo(time_t now);
+  uint64_t sleepUs(uint8_t seconds);
   void config(String datetime); //datetime format is YYYY:MM:DD:HH:MM:SS
   void clearAlarm();
   void read(tmElements_t &tm);
@@ -16,8 +39,13 @@ public:
   uint8_t temperature();
 
 private:
+  void _startCrystal(uint8_t attempts);
+  void _calibrate();
+  void _setPeriod(uint32_t period);
   String _getValue(String data, char separator, int index);
   void _timeval_to_tm(struct timeval *tv, struct tm *tm);
 };
 
+extern RTC_DATA_ATTR slowClockStats slowClock;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "WatchyI2C.h"
+
+RTC_DATA_ATTR i2cStats i2cDevices[I2C_MAX_DEVICES];
+
+static SemaphoreHandle_t busMutex = NULL;
+static QueueHandle_t requestQueue = NULL;
+static uint32_t defaultClock      = I2C_CLOCK_HZ;
+static uint32_t currentClock      = 0;
+static i2cStats unlisted; // counters for devices beyond the table
+// Requests wait() gave up on while still queued. The worker only compares
+// the pointers, the requests themselves may be gone.
+static portMUX_TYPE requestMux = portMUX_INITIALIZER_UNLOCKED;
+static i2cRequest *withdrawn[I2C_QUEUE_DEPTH];
+
+void WatchyI2C::begin(int sda, int scl, uint32_t clock) {
+  if (busMutex == NULL) {
+    busMutex = xSemaphoreCreateRecursiveMutex();
+  }
+  defaultClock = clock;
+  currentClock = clock;
+  Wire.begin(sda, scl, clock);
+}
+
+static void takeBus() {
+  if (busMutex != NULL) {
+    xSemaphoreTakeRecursive(busMutex, portMAX_DELAY);
+  }
+}
+
+void WatchyI2C::setClock(uint8_t address, uint32_t clock) {
+  takeBus();
+  _device(address)->clock = clock;
+  unlock();
+}
+
+void WatchyI2C::lock(uint8_t address) {
+  takeBus();
+  uint32_t clock = defaultClock;
+  if (address != 0) {
+    i2cStats *device = _device(address);
+    if (device->clock != 0) {
+      clock = device->clock;
+    }
+  }
+  if (clock != currentClock) {
+    Wire.setClock(clock);
+    currentClock = clock;
+  }
+}
+
+void WatchyI2C::unlock() {
+  if (busMutex != NULL) {
+    xSemaphoreGiveRecursive(busMutex);
+  }
+}
+
+i2cStats *WatchyI2C::_device(uint8_t address) {
+  for (int i = 0; i < I2C_MAX_DEVICES; i++) {
+    if (i2cDevices[i].address == address) {
+      return &i2cDevices[i];
+    }
+    if (i2cDevices[i].address == 0) {
+      memset(&i2cDevices[i], 0, sizeof(i2cStats));
+      i2cDevices[i].address = address;
+      return &i2cDevices[i];
+    }
+  }
+  unlisted.address = address;
+  return &unlisted;
+}
+
+void WatchyI2C::_count(i2cStats *device, uint8_t result, size_t length) {
+  device->transactions++;
+  if (result == I2C_OK) {
+    device->bytes += length;
+  } else {
+    device->errors++;
+    device->lastError = result;
+  }
+}
+
+// Absence is expected when telling boards apart, so a probe is neither
+// retried nor counted
+bool WatchyI2C::probe(uint8_t address) {
+  lock();
+  Wire.beginTransmission(address);
+  bool found = Wire.endTransmission() == 0;
+  unlock();
+  return found;
+}
+
+// One burst: register address, repeated start, read
+uint8_t WatchyI2C::_read(uint8_t address, uint8_t reg, uint8_t *data,
+                         size_t length) {
+  Wire.beginTransmission(address);
+  Wire.write(reg);
+  uint8_t error = Wire.endTransmission(false);
+  if (error != 0) {
+    return error;
+  }
+  size_t count = Wire.requestFrom((uint16_t)address, length, true);
+  for (size_t i = 0; i < count; i++) {
+    data[i] = Wire.read();
+  }
+  return count == length ? I2C_OK : I2C_ERR_SHORT;
+}
+
+uint8_t WatchyI2C::read(uint8_t address, uint8_t reg, uint8_t *data,
+                        size_t length, bool increment) {
+  lock(address);
+  i2cStats *device = _device(address);
+  uint8_t result   = I2C_OK;
+  size_t done      = 0;
+  while (done < length && result == I2C_OK) {
+    size_t burst  = min(length - done, (size_t)I2C_BUFFER_LENGTH);
+    uint8_t start = increment ? reg + done : reg;
+    for (int attempt = 0;; attempt++) {
+      result = _read(address, start, data + done, burst);
+      if (result == I2C_OK || attempt == I2C_RETRIES) {
+        break;
+      }
+      device->retries++;
+      delayMicroseconds(I2C_RETRY_DELAY_US);
+    }
+    _count(device, result, burst);
+    done += burst;
+  }
+  unlock();
+  return result;
+}
+
+uint8_t WatchyI2C::write(uint8_t address, uint8_t reg, const uint8_t *data,
+                         size_t length) {
+  if (length >= I2C_BUFFER_LENGTH) {
+    return I2C_ERR_LENGTH;
+  }
+  lock(address);
+  i2cStats *device = _device(address);
+  uint8_t result   = I2C_OK;
+  for (int attempt = 0;; attempt++) {
+    Wire.beginTransmission(address);
+    Wire.write(reg);
+    Wire.write(data, length);
+    result = Wire.endTransmission();
+    if (result == I2C_OK || attempt == I2C_RETRIES) {
+      break;
+    }
+    device->retries++;
+    delayMicroseconds(I2C_RETRY_DELAY_US);
+  }
+  _count(device, result, length);
+  unlock();
+  return result;
+}
+
+void WatchyI2C::_workerTask(void *param) {
+  i2cRequest *request;
+  for (;;) {
+    if (xQueueReceive(requestQueue, &request, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    bool skip = false;
+    portENTER_CRITICAL(&requestMux);
+    for (int i = 0; i < I2C_QUEUE_DEPTH && !skip; i++) {
+      if (withdrawn[i] == request) {
+        withdrawn[i] = NULL;
+        skip         = true;
+      }
+    }
+    if (!skip) {
+      request->result = I2C_BUSY;
+    }
+    portEXIT_CRITICAL(&requestMux);
+    if (!skip) {
+      request->result = read(request->address, request->reg, request->data,
+                             request->length, request->increment);
+    }
+  }
+}
+
+// Queues a read for the worker task, so the caller can drive the display
+// over SPI meanwhile and pick the result up with wait()
+bool WatchyI2C::readAsync(i2cRequest &request) {
+  if (requestQueue == NULL) {
+    requestQueue = xQueueCreate(I2C_QUEUE_DEPTH, sizeof(i2cRequest *));
+    if (requestQueue == NULL) {
+      request.result = I2C_ERR_QUEUE;
+      return false;
+    }
+    xTaskCreate(_workerTask, "i2c", 2048, NULL, I2C_WORKER_PRIORITY, NULL);
+  }
+  request.result   = I2C_PENDING;
+  i2cRequest *item = &request;
+  if (xQueueSend(requestQueue, &item, 0) != pdTRUE) {
+    request.result = I2C_ERR_QUEUE;
+    return false;
+  }
+  return true;
+}
+
+// On a timeout a request still in the queue is withdrawn, so the worker
+// never touches it again; one the worker already took is waited out, the
+// bus transfer itself is bounded by Wire's timeout.
+uint8_t WatchyI2C::wait(i2cRequest &request, uint32_t timeoutMs) {
+  uint32_t start = millis();
+  while (request.result == I2C_PENDING || request.result == I2C_BUSY) {
+    if (millis() - start >= timeoutMs) {
+      bool withdraw = false;
+      portENTER_CRITICAL(&requestMux);
+      if (request.result == I2C_PENDING) {
+        // one free slot always exists, every entry is still in the queue
+        for (int i = 0; i < I2C_QUEUE_DEPTH && !withdraw; i++) {
+          if (withdrawn[i] == NULL) {
+            withdrawn[i] = &request;
+            withdraw     = true;
+          }
+        }
+        request.result = I2C_ERR_TIMEOUT;
+      }
+      portEXIT_CRITICAL(&requestMux);
+      if (withdraw) {
+        return I2C_ERR_TIMEOUT;
+      }
+      while (request.result == I2C_BUSY) {
+        delay(1);
+      }
+      return request.result;
+    }
+    delay(1);
+  }
+  return request.result;
+}
+
+const i2cStats *WatchyI2C::stats(uint8_t address) {
+  for (int i = 0; i < I2C_MAX_DEVICES; i++) {
+    if (i2cDevices[i].address == address) {
+      return &i2cDevices[i];
+    }
+  }
+  return NULL;
+}
+
+void WatchyI2C::resetStats() {
+  lock();
+  for (int i = 0; i < I2C_MAX_DEVICES; i++) {
+    i2cDevices[i].lastError    = I2C_OK;
+    i2cDevices[i].transactions = 0;
+    i2cDevices[i].bytes        = 0;
+    i2cDevices[i].retries      = 0;
+    i2cDevices[i].errors       = 0;
+  }
+  unlock();
+}
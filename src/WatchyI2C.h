@@ -0,0 +1,89 @@
+#ifndef WATCHY_I2C_H
+#define WATCHY_I2C_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "config.h"
+
+#ifndef I2C_BUFFER_LENGTH
+#define I2C_BUFFER_LENGTH 128
+#endif
+
+// Results, the first five match Wire.endTransmission()
+#define I2C_OK            0
+#define I2C_ERR_LENGTH    1 // write longer than the Wire buffer
+#define I2C_ERR_NACK      2 // address not acknowledged
+#define I2C_ERR_NACK_DATA 3 // data not acknowledged
+#define I2C_ERR_BUS       4 // arbitration lost or bus not started
+#define I2C_ERR_TIMEOUT   5
+#define I2C_ERR_SHORT     6 // fewer bytes read than requested
+#define I2C_ERR_QUEUE     7 // async queue full
+#define I2C_BUSY          0xFE // taken by the worker
+#define I2C_PENDING       0xFF
+
+// Per device counters, kept in RTC memory so they add up across deep sleep
+typedef struct i2cStats {
+  uint8_t address; // 0 for an unused slot
+  uint8_t lastError;
+  uint32_t clock; // 0 for the bus default
+  uint32_t transactions;
+  uint32_t bytes;
+  uint32_t retries;
+  uint32_t errors;
+} i2cStats;
+
+// A read queued with readAsync(); result stays I2C_PENDING (or I2C_BUSY)
+// until it is done. The request and its buffer must stay valid until wait()
+// returns, which on a timeout withdraws a queued request and otherwise waits
+// for the worker to finish with it.
+typedef struct i2cRequest {
+  uint8_t address;
+  uint8_t reg;
+  bool increment;
+  uint8_t *data;
+  uint16_t length;
+  volatile uint8_t result;
+} i2cRequest;
+
+// Bus layer shared by the RTC, the BMA423 and the watch itself. Register reads
+// use a repeated start, reads longer than the Wire buffer are split in bursts
+// (advancing the register unless increment is false, as for a FIFO data
+// register), failed transfers are retried and every device can run at its
+// own clock.
+class WatchyI2C {
+public:
+  static void begin(int sda, int scl, uint32_t clock = I2C_CLOCK_HZ);
+  static void setClock(uint8_t address, uint32_t clock);
+  static bool probe(uint8_t address);
+  static uint8_t read(uint8_t address, uint8_t reg, uint8_t *data,
+                      size_t length, bool increment = true);
+  static uint8_t write(uint8_t address, uint8_t reg, const uint8_t *data,
+                       size_t length);
+  static bool readAsync(i2cRequest &request);
+  static uint8_t wait(i2cRequest &request, uint32_t timeoutMs);
+  static const i2cStats *stats(uint8_t address);
+  static void resetStats();
+  // Takes the bus and sets the clock for address (the bus default for 0).
+  // Drivers that talk to Wire themselves (DS3232RTC, Rtc_Pcf8563) hold it so
+  // their transactions do not interleave with queued reads.
+  static void lock(uint8_t address = 0);
+  static void unlock();
+
+private:
+  static i2cStats *_device(uint8_t address);
+  static uint8_t _read(uint8_t address, uint8_t reg, uint8_t *data,
+                       size_t length);
+  static void _count(i2cStats *device, uint8_t result, size_t length);
+  static void _workerTask(void *param);
+};
+
+// Holds the bus lock for the rest of the scope
+class I2CLock {
+public:
+  I2CLock(uint8_t address = 0) { WatchyI2C::lock(address); }
+  ~I2CLock() { WatchyI2C::unlock(); }
+};
+
+#endif
@@ -1,151 +1,337 @@
 #include "WatchyRTC.h"
 
-WatchyRTC::WatchyRTC(){}
+// DS3231 registers
+#define DS_TIME_REG    0x00 // seconds .. year, 7 bytes
+#define DS_STATUS_REG  0x0F
+#define DS_STATUS_A2F  0x02
 
-void WatchyRTC::init() {
-  byte error;
-  Wire.beginTransmission(RTC_DS_ADDR);
-  error = Wire.endTransmission();
-  if (error == 0) {
-    rtcType = DS3231;
-    rtc_ds.begin();
-  } else {
-    Wire.beginTransmission(RTC_PCF_ADDR);
-    error = Wire.endTransmission();
-    if (error == 0) {
-      rtcType = PCF8563;
-    } else {
-      // RTC Error
+// PCF8563 registers
+#define PCF_STATUS2_REG 0x01 // followed by seconds .. year
+#define PCF_TIME_REG    0x02
+#define PCF_ALARM_REG   0x09 // minute, hour, day, weekday
+#define PCF_TIMER_REG   0x0E // timer control, timer value
+#define PCF_STATUS2_TIE 0x01
+#define PCF_STATUS2_AIE 0x02
+#define PCF_STATUS2_TF  0x04
+#define PCF_STATUS2_AF  0x08
+#define PCF_STATUS2_TP  0x10 // pulsed instead of level timer interrupt
+#define PCF_ALARM_OFF   0x80
+#define PCF_TIMER_1HZ   0x82 // enabled, 1 Hz source
+#define PCF_TIMER_OFF   0x03 // disabled, 1/60 Hz source draws the least
+
+// BCD to binary for 0x00 .. 0x99, the rows past 9 are never valid BCD
+#define BCD_ROW(tens)                                                          \
+  tens * 10, tens * 10 + 1, tens * 10 + 2, tens * 10 + 3, tens * 10 + 4,       \
+      tens * 10 + 5, tens * 10 + 6, tens * 10 + 7, tens * 10 + 8,              \
+      tens * 10 + 9, 0, 0, 0, 0, 0, 0
+static const uint8_t bcdTable[160] = {
+    BCD_ROW(0), BCD_ROW(1), BCD_ROW(2), BCD_ROW(3), BCD_ROW(4),
+    BCD_ROW(5), BCD_ROW(6), BCD_ROW(7), BCD_ROW(8), BCD_ROW(9)};
+
+uint8_t RTCDateTime::fromBCD(uint8_t value) {
+  return value < sizeof(bcdTable) ? bcdTable[value] : 0;
+}
+
+static uint32_t _transactions(uint8_t address) {
+  const i2cStats *stats = WatchyI2C::stats(address);
+  return stats != NULL ? stats->transactions : 0;
+}
+
+bool RTCDateTime::parse(String datetime, tmElements_t &tm) {
+  if (datetime == "") {
+    return false;
+  }
+  tm.Year = CalendarYrToTm(_getValue(datetime, ':', 0).toInt()); // YYYY -
+                                                                 // 1970
+  tm.Month  = _getValue(datetime, ':', 1).toInt();
+  tm.Day    = _getValue(datetime, ':', 2).toInt();
+  tm.Hour   = _getValue(datetime, ':', 3).toInt();
+  tm.Minute = _getValue(datetime, ':', 4).toInt();
+  tm.Second = _getValue(datetime, ':', 5).toInt();
+  time_t t  = makeTime(tm); // make and break to calculate tm.Wday
+  breakTime(t, tm);
+  return true;
+}
+
+String RTCDateTime::_getValue(String data, char separator, int index) {
+  int found      = 0;
+  int strIndex[] = {0, -1};
+  int maxIndex   = data.length() - 1;
+
+  for (int i = 0; i <= maxIndex && found <= index; i++) {
+    if (data.charAt(i) == separator || i == maxIndex) {
+      found++;
+      strIndex[0] = strIndex[1] + 1;
+      strIndex[1] = (i == maxIndex) ? i + 1 : i;
     }
   }
+
+  return found > index ? data.substring(strIndex[0], strIndex[1]) : "";
 }
 
-void WatchyRTC::config(
-    String datetime) { // String datetime format is YYYY:MM:DD:HH:MM:SS
-  if (rtcType == DS3231) {
-    _DSConfig(datetime);
+#if WATCHY_RTC_BACKEND != PCF8563
+const uint8_t WatchyRTCDS3231::rtcType;
+
+bool WatchyRTCDS3231::init(uint8_t knownType) {
+  I2CLock lock;
+  if (knownType == 0 ? !WatchyI2C::probe(RTC_DS_ADDR) : knownType != DS3231) {
+    return false;
+  }
+  rtc_ds.begin();
+  return true;
+}
+
+void WatchyRTCDS3231::config(
+    String datetime) { // String datetime is YYYY:MM:DD:HH:MM:SS
+  I2CLock lock;
+  tmElements_t tm;
+  if (RTCDateTime::parse(datetime, tm)) {
+    rtc_ds.set(makeTime(tm));
+  }
+  // https://github.com/JChristensen/DS3232RTC
+  rtc_ds.squareWave(DS3232RTC::SQWAVE_NONE); // disable square wave output
+  rtc_ds.setAlarm(DS3232RTC::ALM2_EVERY_MINUTE, 0, 0, 0,
+                  0); // alarm wakes up Watchy every minute
+  rtc_ds.alarmInterrupt(DS3232RTC::ALARM_2, true); // enable alarm interrupt
+}
+
+// One write clearing A2F, with the status read() already fetched. The
+// ALM2_EVERY_MINUTE alarm from config() re-arms itself.
+void WatchyRTCDS3231::clearAlarm() {
+  I2CLock lock;
+  if (!_statusValid && !_readStatus()) {
+    return;
+  }
+  uint8_t status = _status & ~DS_STATUS_A2F;
+  WatchyI2C::write(RTC_DS_ADDR, DS_STATUS_REG, &status, 1);
+  _status = status;
+}
+
+// Time and status in one burst, 0x00 .. 0x0F
+void WatchyRTCDS3231::read(tmElements_t &tm) {
+  uint8_t regs[DS_STATUS_REG + 1];
+  if (WatchyI2C::read(RTC_DS_ADDR, DS_TIME_REG, regs, sizeof(regs)) !=
+      I2C_OK) {
+    return;
+  }
+  tm.Second    = RTCDateTime::fromBCD(regs[0] & 0x7F);
+  tm.Minute    = RTCDateTime::fromBCD(regs[1] & 0x7F);
+  tm.Hour      = RTCDateTime::fromBCD(regs[2] & 0x3F); // 24 hour mode
+  tm.Wday      = regs[3] & 0x07;
+  tm.Day       = RTCDateTime::fromBCD(regs[4] & 0x3F);
+  tm.Month     = RTCDateTime::fromBCD(regs[5] & 0x1F);
+  tm.Year      = y2kYearToTm(RTCDateTime::fromBCD(regs[6]));
+  _status      = regs[DS_STATUS_REG];
+  _statusValid = true;
+}
+
+bool WatchyRTCDS3231::_readStatus() {
+  _statusValid = WatchyI2C::read(RTC_DS_ADDR, DS_STATUS_REG, &_status, 1) ==
+                 I2C_OK;
+  return _statusValid;
+}
+
+void WatchyRTCDS3231::set(tmElements_t tm) {
+  I2CLock lock;
+  rtc_ds.set(makeTime(tm));
+}
+
+uint8_t WatchyRTCDS3231::temperature() {
+  I2CLock lock;
+  return rtc_ds.temperature();
+}
+
+uint32_t WatchyRTCDS3231::transactions() { return _transactions(RTC_DS_ADDR); }
+
+bool WatchyRTCDS3231::setCountdown(uint8_t seconds) {
+  return seconds == 0; // alarm 1 cannot repeat faster than once a second
+}
+#endif
+
+#if WATCHY_RTC_BACKEND != DS3231
+const uint8_t WatchyRTCPCF8563::rtcType;
+
+bool WatchyRTCPCF8563::init(uint8_t knownType) {
+  if (knownType != 0) {
+    return knownType == PCF8563;
+  }
+  I2CLock lock;
+  return WatchyI2C::probe(RTC_PCF_ADDR);
+}
+
+void WatchyRTCPCF8563::config(
+    String datetime) { // String datetime is YYYY:MM:DD:HH:MM:SS
+  tmElements_t tm;
+  if (RTCDateTime::parse(datetime, tm)) {
+    set(tm);
   } else {
-    _PCFConfig(datetime);
+    // on POR event, PCF8563 sets month to 0, which will give an error since
+    // months are 1-12
+    clearAlarm();
   }
+  setCountdown(0); // the timer keeps running across an ESP32 reset
 }
 
-void WatchyRTC::clearAlarm() {
-  if (rtcType == DS3231) {
-    rtc_ds.alarm(DS3232RTC::ALARM_2);
+// Clears AF and TF and sets the minute alarm for the next minute: a write to
+// control/status 2 and one to the four alarm registers, no reads when read()
+// ran this minute.
+void WatchyRTCPCF8563::clearAlarm() {
+  I2CLock lock;
+  tmElements_t tm;
+  if (millis() - _readMs >= _freshMs && !_readTime(tm)) {
+    return;
+  }
+  uint8_t status =
+      (_status & ~(PCF_STATUS2_AF | PCF_STATUS2_TF)) | PCF_STATUS2_AIE;
+  uint8_t alarm[4] = {RTCDateTime::toBCD((_minute + 1) % 60), PCF_ALARM_OFF,
+                      PCF_ALARM_OFF, PCF_ALARM_OFF};
+  WatchyI2C::write(RTC_PCF_ADDR, PCF_STATUS2_REG, &status, 1);
+  WatchyI2C::write(RTC_PCF_ADDR, PCF_ALARM_REG, alarm, sizeof(alarm));
+  _status = status;
+}
+
+void WatchyRTCPCF8563::read(tmElements_t &tm) { _readTime(tm); }
+
+// Control/status 2 and the time in one 8 byte burst
+bool WatchyRTCPCF8563::_readTime(tmElements_t &tm) {
+  uint8_t regs[8];
+  if (WatchyI2C::read(RTC_PCF_ADDR, PCF_STATUS2_REG, regs, sizeof(regs)) !=
+      I2C_OK) {
+    _freshMs = 0;
+    return false;
+  }
+  _status   = regs[0];
+  tm.Second = RTCDateTime::fromBCD(regs[1] & 0x7F);
+  tm.Minute = RTCDateTime::fromBCD(regs[2] & 0x7F);
+  tm.Hour   = RTCDateTime::fromBCD(regs[3] & 0x3F);
+  tm.Day    = RTCDateTime::fromBCD(regs[4] & 0x3F);
+  tm.Wday   = (regs[5] & 0x07) + 1; // TimeLib & DS3231 has Wday range of 1-7,
+                                    // but PCF8563 stores it in 0-6 range
+  tm.Month  = RTCDateTime::fromBCD(regs[6] & 0x1F);
+  tm.Year   = y2kYearToTm(RTCDateTime::fromBCD(regs[7]));
+  _minute   = tm.Minute;
+  _readMs   = millis();
+  _freshMs  = (59 - min(tm.Second, (uint8_t)59)) * 1000UL;
+  return true;
+}
+
+// Time in one 7 byte burst, which also clears the VL flag
+void WatchyRTCPCF8563::set(tmElements_t tm) {
+  I2CLock lock;
+  time_t t = makeTime(tm); // make and break to calculate tm.Wday
+  breakTime(t, tm);
+  uint8_t regs[7] = {RTCDateTime::toBCD(tm.Second),
+                     RTCDateTime::toBCD(tm.Minute),
+                     RTCDateTime::toBCD(tm.Hour),
+                     RTCDateTime::toBCD(tm.Day),
+                     (uint8_t)(tm.Wday - 1), // PCF8563 weekday is 0-6
+                     RTCDateTime::toBCD(tm.Month), // century bit 0 is 20xx
+                     RTCDateTime::toBCD(tmYearToY2k(tm.Year))};
+  if (WatchyI2C::write(RTC_PCF_ADDR, PCF_TIME_REG, regs, sizeof(regs)) !=
+      I2C_OK) {
+    return;
+  }
+  _freshMs = 0; // clearAlarm() reads back the new time and status
+  clearAlarm();
+}
+
+uint8_t WatchyRTCPCF8563::temperature() {
+  return 255; // error, no temperature sensor
+}
+
+uint32_t WatchyRTCPCF8563::transactions() {
+  return _transactions(RTC_PCF_ADDR);
+}
+
+// The countdown shares INT with the alarm, so both wake through RTC_INT_PIN.
+// It runs from the RTC crystal and reloads itself; the level interrupt holds
+// until clearAlarm() clears TF. Writing 1 to AF leaves a pending alarm set.
+bool WatchyRTCPCF8563::setCountdown(uint8_t seconds) {
+  I2CLock lock;
+  uint8_t timer[2] = {PCF_TIMER_OFF, 0};
+  if (WatchyI2C::write(RTC_PCF_ADDR, PCF_TIMER_REG, timer, sizeof(timer)) !=
+          I2C_OK ||
+      WatchyI2C::read(RTC_PCF_ADDR, PCF_STATUS2_REG, &_status, 1) != I2C_OK) {
+    return false;
+  }
+  uint8_t status = (_status & ~(PCF_STATUS2_TF | PCF_STATUS2_TP)) |
+                   PCF_STATUS2_AF;
+  if (seconds > 0) {
+    status |= PCF_STATUS2_TIE;
   } else {
-    int nextAlarmMinute = 0;
-    rtc_pcf.clearAlarm(); // resets the alarm flag in the RTC
-    nextAlarmMinute = rtc_pcf.getMinute();
-    nextAlarmMinute =
-        (nextAlarmMinute == 59)
-            ? 0
-            : (nextAlarmMinute + 1); // set alarm to trigger 1 minute from now
-    rtc_pcf.setAlarm(nextAlarmMinute, 99, 99, 99);
+    status &= ~PCF_STATUS2_TIE;
   }
+  if (WatchyI2C::write(RTC_PCF_ADDR, PCF_STATUS2_REG, &status, 1) != I2C_OK) {
+    return false;
+  }
+  _status = status;
+  if (seconds == 0) {
+    return true;
+  }
+  timer[0] = PCF_TIMER_1HZ;
+  timer[1] = seconds;
+  return WatchyI2C::write(RTC_PCF_ADDR, PCF_TIMER_REG, timer, sizeof(timer)) ==
+         I2C_OK;
 }
+#endif
 
-void WatchyRTC::read(tmElements_t &tm) {
-  if (rtcType == DS3231) {
-    rtc_ds.read(tm);
+#if WATCHY_RTC_BACKEND == 0
+WatchyRTCProbe::WatchyRTCProbe() : rtcType(0) {}
+
+bool WatchyRTCProbe::init(uint8_t knownType) {
+  if (ds.init(knownType)) {
+    rtcType = DS3231;
+  } else if (pcf.init(knownType)) {
+    rtcType = PCF8563;
   } else {
-    rtc_pcf.getDate();
-    tm.Year  = y2kYearToTm(rtc_pcf.getYear());
-    tm.Month = rtc_pcf.getMonth();
-    tm.Day   = rtc_pcf.getDay();
-    tm.Wday =
-        rtc_pcf.getWeekday() + 1; // TimeLib & DS3231 has Wday range of 1-7, but
-                                  // PCF8563 stores day of week in 0-6 range
-    tm.Hour   = rtc_pcf.getHour();
-    tm.Minute = rtc_pcf.getMinute();
-    tm.Second = rtc_pcf.getSecond();
+    return false; // RTC Error
   }
+  return true;
 }
 
-void WatchyRTC::set(tmElements_t tm) {
+void WatchyRTCProbe::config(
+    String datetime) { // String datetime format is YYYY:MM:DD:HH:MM:SS
   if (rtcType == DS3231) {
-    time_t t = makeTime(tm);
-    rtc_ds.set(t);
+    ds.config(datetime);
   } else {
-    time_t t = makeTime(tm); // make and break to calculate tm.Wday
-    breakTime(t, tm);
-    // day, weekday, month, century(1=1900, 0=2000), year(0-99)
-    rtc_pcf.setDate(
-        tm.Day, tm.Wday - 1, tm.Month, 0,
-        tmYearToY2k(tm.Year)); // TimeLib & DS3231 has Wday range of 1-7, but
-                               // PCF8563 stores day of week in 0-6 range
-    // hr, min, sec
-    rtc_pcf.setTime(tm.Hour, tm.Minute, tm.Second);
-    clearAlarm();
+    pcf.config(datetime);
   }
 }
 
-uint8_t WatchyRTC::temperature() {
+void WatchyRTCProbe::clearAlarm() {
   if (rtcType == DS3231) {
-    return rtc_ds.temperature();
+    ds.clearAlarm();
   } else {
-    return 255; // error
+    pcf.clearAlarm();
   }
 }
 
-void WatchyRTC::_DSConfig(
-    String datetime) { // String datetime is YYYY:MM:DD:HH:MM:SS
-  if (datetime != "") {
-    tmElements_t tm;
-    tm.Year = CalendarYrToTm(_getValue(datetime, ':', 0).toInt()); // YYYY -
-                                                                   // 1970
-    tm.Month  = _getValue(datetime, ':', 1).toInt();
-    tm.Day    = _getValue(datetime, ':', 2).toInt();
-    tm.Hour   = _getValue(datetime, ':', 3).toInt();
-    tm.Minute = _getValue(datetime, ':', 4).toInt();
-    tm.Second = _getValue(datetime, ':', 5).toInt();
-    time_t t  = makeTime(tm);
-    rtc_ds.set(t);
+void WatchyRTCProbe::read(tmElements_t &tm) {
+  if (rtcType == DS3231) {
+    ds.read(tm);
+  } else {
+    pcf.read(tm);
   }
-  // https://github.com/JChristensen/DS3232RTC
-  rtc_ds.squareWave(DS3232RTC::SQWAVE_NONE); // disable square wave output
-  rtc_ds.setAlarm(DS3232RTC::ALM2_EVERY_MINUTE, 0, 0, 0,
-                  0); // alarm wakes up Watchy every minute
-  rtc_ds.alarmInterrupt(DS3232RTC::ALARM_2, true); // enable alarm interrupt
 }
 
-void WatchyRTC::_PCFConfig(
-    String datetime) { // String datetime is YYYY:MM:DD:HH:MM:SS
-  if (datetime != "") {
-    tmElements_t tm;
-    tm.Year = CalendarYrToTm(_getValue(datetime, ':', 0).toInt()); // YYYY -
-                                                                   // 1970
-    tm.Month  = _getValue(datetime, ':', 1).toInt();
-    tm.Day    = _getValue(datetime, ':', 2).toInt();
-    tm.Hour   = _getValue(datetime, ':', 3).toInt();
-    tm.Minute = _getValue(datetime, ':', 4).toInt();
-    tm.Second = _getValue(datetime, ':', 5).toInt();
-    time_t t  = makeTime(tm); // make and break to calculate tm.Wday
-    breakTime(t, tm);
-    // day, weekday, month, century(1=1900, 0=2000), year(0-99)
-    rtc_pcf.setDate(
-        tm.Day, tm.Wday - 1, tm.Month, 0,
-        tmYearToY2k(tm.Year)); // TimeLib & DS3231 has Wday range of 1-7, but
-                               // PCF8563 stores day of week in 0-6 range
-    // hr, min, sec
-    rtc_pcf.setTime(tm.Hour, tm.Minute, tm.Second);
-  }
-  // on POR event, PCF8563 sets month to 0, which will give an error since
-  // months are 1-12
-  clearAlarm();
+void WatchyRTCProbe::set(tmElements_t tm) {
+  if (rtcType == DS3231) {
+    ds.set(tm);
+  } else {
+    pcf.set(tm);
+  }
 }
 
-String WatchyRTC::_getValue(String data, char separator, int index) {
-  int found      = 0;
-  int strIndex[] = {0, -1};
-  int maxIndex   = data.length() - 1;
+uint8_t WatchyRTCProbe::temperature() {
+  return rtcType == DS3231 ? ds.temperature() : pcf.temperature();
+}
 
-  for (int i = 0; i <= maxIndex && found <= index; i++) {
-    if (data.charAt(i) == separator || i == maxIndex) {
-      found++;
-      strIndex[0] = strIndex[1] + 1;
-      strIndex[1] = (i == maxIndex) ? i + 1 : i;
-    }
-  }
+uint32_t WatchyRTCProbe::transactions() {
+  return rtcType == DS3231 ? ds.transactions() : pcf.transactions();
+}
 
-  return found > index ? data.substring(strIndex[0], strIndex[1]) : "";
+bool WatchyRTCProbe::setCountdown(uint8_t seconds) {
+  return rtcType == DS3231 ? ds.setCountdown(seconds)
+                           : pcf.setCountdown(seconds);
 }
+#endif
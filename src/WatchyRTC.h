@@ -1,10 +1,9 @@
 #ifndef WATCHY_RTC_H
 #define WATCHY_RTC_H
 
+#include "WatchyI2C.h"
 #include "config.h"
 #include "time.h"
-#include <DS3232RTC.h>
-#include <Rtc_Pcf8563.h>
 
 #define DS3231          1
 #define PCF8563         2
@@ -13,26 +12,110 @@
 #define YEAR_OFFSET_DS  1970
 #define YEAR_OFFSET_PCF 2000
 
-class WatchyRTC {
+// The board revision fixes the RTC chip, so WatchyRTC is a typedef for that
+// chip's class and every call is a direct one. Only generic builds, where
+// config.h had to guess the revision, link both drivers and probe the bus.
+#if defined(RTC_TYPE) && !defined(RTC_TYPE_PROBE)
+  #define WATCHY_RTC_BACKEND RTC_TYPE
+#else
+  #define WATCHY_RTC_BACKEND 0
+#endif
+
+#if WATCHY_RTC_BACKEND != PCF8563
+  #include <DS3232RTC.h>
+#endif
+#if WATCHY_RTC_BACKEND != DS3231
+  #include <Rtc_Pcf8563.h>
+#endif
+
+// Parses the YYYY:MM:DD:HH:MM:SS string handed to config() and converts the
+// chips' BCD registers
+class RTCDateTime {
+public:
+  static bool parse(String datetime, tmElements_t &tm);
+  static uint8_t fromBCD(uint8_t value);
+  static uint8_t toBCD(uint8_t value) { return (value / 10) << 4 | value % 10; }
+
+private:
+  static String _getValue(String data, char separator, int index);
+};
+
+// One class per chip with the same interface. init() probes the bus unless
+// knownType says which chip was found before, and is false when it does not
+// answer. setCountdown() raises the RTC interrupt every 1-255 seconds on top
+// of the minute alarm (0 stops it); false when the chip has no timer.
+#if WATCHY_RTC_BACKEND != PCF8563
+class WatchyRTCDS3231 {
 public:
+  static const uint8_t rtcType = DS3231;
   DS3232RTC rtc_ds;
+
+public:
+  bool init(uint8_t knownType = 0);
+  void config(String datetime); // String datetime format is YYYY:MM:DD:HH:MM:SS
+  void clearAlarm();
+  void read(tmElements_t &tm);
+  void set(tmElements_t tm);
+  uint8_t temperature();
+  uint32_t transactions(); // I2C transactions with the chip so far
+  bool setCountdown(uint8_t seconds);
+
+private:
+  bool _readStatus();
+  uint8_t _status; // control/status register from the last read()
+  bool _statusValid = false;
+};
+#endif
+
+#if WATCHY_RTC_BACKEND != DS3231
+class WatchyRTCPCF8563 {
+public:
+  static const uint8_t rtcType = PCF8563;
   Rtc_Pcf8563 rtc_pcf;
-  uint8_t rtcType;
 
 public:
-  WatchyRTC();
-  void init();
+  bool init(uint8_t knownType = 0);
   void config(String datetime); // String datetime format is YYYY:MM:DD:HH:MM:SS
   void clearAlarm();
   void read(tmElements_t &tm);
   void set(tmElements_t tm);
   uint8_t temperature();
+  uint32_t transactions(); // I2C transactions with the chip so far
+  bool setCountdown(uint8_t seconds);
 
 private:
-  void _DSConfig(String datetime);
-  void _PCFConfig(String datetime);
-  int _getDayOfWeek(int d, int m, int y);
-  String _getValue(String data, char separator, int index);
+  bool _readTime(tmElements_t &tm);
+  uint8_t _status; // control/status 2 from the last read()
+  uint8_t _minute;
+  uint32_t _readMs;
+  uint32_t _freshMs = 0; // _minute is current for this long after _readMs
+};
+#endif
+
+#if WATCHY_RTC_BACKEND == DS3231
+typedef WatchyRTCDS3231 WatchyRTC;
+#elif WATCHY_RTC_BACKEND == PCF8563
+typedef WatchyRTCPCF8563 WatchyRTC;
+#else
+// Generic build: init() finds the chip and each call branches on rtcType
+class WatchyRTCProbe {
+public:
+  WatchyRTCDS3231 ds;
+  WatchyRTCPCF8563 pcf;
+  uint8_t rtcType;
+
+public:
+  WatchyRTCProbe();
+  bool init(uint8_t knownType = 0);
+  void config(String datetime); // String datetime format is YYYY:MM:DD:HH:MM:SS
+  void clearAlarm();
+  void read(tmElements_t &tm);
+  void set(tmElements_t tm);
+  uint8_t temperature();
+  uint32_t transactions();
+  bool setCountdown(uint8_t seconds);
 };
+typedef WatchyRTCProbe WatchyRTC;
+#endif
 
-#endif
\ No newline at end of file
+#endif
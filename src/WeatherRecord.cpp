@@ -0,0 +1,57 @@
+#include "WeatherRecord.h"
+
+static uint32_t _be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t _be16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+
+uint16_t weatherRecordCRC(const uint8_t *data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+size_t buildWeatherRequest(uint8_t *buffer, bool metric, uint32_t nonce) {
+  buffer[0] = 'W';
+  buffer[1] = 'Q';
+  buffer[2] = WEATHER_RECORD_VERSION;
+  buffer[3] = metric ? WEATHER_FLAG_METRIC : 0;
+  buffer[4] = nonce >> 24;
+  buffer[5] = nonce >> 16;
+  buffer[6] = nonce >> 8;
+  buffer[7] = nonce;
+  return WEATHER_REQUEST_SIZE;
+}
+
+bool parseWeatherRecord(const uint8_t *data, size_t length,
+                        weatherRecord &record) {
+  if (length < WEATHER_RECORD_HEADER_SIZE + 2 || data[0] != 'W' ||
+      data[1] != 'X' || data[2] != WEATHER_RECORD_VERSION) {
+    return false;
+  }
+  uint8_t descLength = data[9];
+  size_t size        = WEATHER_RECORD_HEADER_SIZE + descLength;
+  if (descLength > WEATHER_RECORD_DESC_LEN || length < size + 2 ||
+      weatherRecordCRC(data, size) != _be16(&data[size])) {
+    return false;
+  }
+  record.flags                = data[3];
+  record.nonce                = _be32(&data[4]);
+  record.temperature          = (int8_t)data[8];
+  record.weatherConditionCode = (int16_t)_be16(&data[10]);
+  record.sunrise              = (int32_t)_be32(&data[12]);
+  record.sunset               = (int32_t)_be32(&data[16]);
+  record.timezone             = (int32_t)_be32(&data[20]);
+  record.time                 = _be32(&data[24]);
+  record.timeMs               = _be16(&data[28]);
+  memcpy(record.description, &data[WEATHER_RECORD_HEADER_SIZE], descLength);
+  record.description[descLength] = '\0';
+  return true;
+}
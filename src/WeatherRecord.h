@@ -0,0 +1,44 @@
+#ifndef WEATHER_RECORD_H
+#define WEATHER_RECORD_H
+
+#include <Arduino.h>
+
+// Compact binary weather record served by extras/tools/weather_proxy.py, in
+// place of the OpenWeatherMap JSON. All fields are big endian.
+//
+//  0  'W' 'X' version flags   flags: bit 0 metric, bit 1 time valid
+//  4  nonce (u32)             echoed from the request
+//  8  temperature (i8) description length (u8) condition code (i16)
+// 12  sunrise (i32)  16  sunset (i32)  20  timezone offset (i32, seconds)
+// 24  proxy time (u32, unix)  28  milliseconds (u16)
+// 30  description (ASCII, up to 15 bytes)  then CRC-16/CCITT of all above
+//
+// A request is 'W' 'Q' version flags nonce, 8 bytes.
+
+#define WEATHER_RECORD_VERSION     1
+#define WEATHER_RECORD_HEADER_SIZE 30
+#define WEATHER_RECORD_DESC_LEN    15
+#define WEATHER_RECORD_MAX_SIZE    (WEATHER_RECORD_HEADER_SIZE + WEATHER_RECORD_DESC_LEN + 2)
+#define WEATHER_REQUEST_SIZE       8
+#define WEATHER_FLAG_METRIC        0x01
+#define WEATHER_FLAG_TIME          0x02
+
+typedef struct weatherRecord {
+  uint32_t nonce;
+  uint8_t flags;
+  int8_t temperature;
+  int16_t weatherConditionCode;
+  int32_t sunrise;
+  int32_t sunset;
+  int32_t timezone;
+  uint32_t time;
+  uint16_t timeMs;
+  char description[WEATHER_RECORD_DESC_LEN + 1];
+} weatherRecord;
+
+uint16_t weatherRecordCRC(const uint8_t *data, size_t length);
+size_t buildWeatherRequest(uint8_t *buffer, bool metric, uint32_t nonce);
+bool parseWeatherRecord(const uint8_t *data, size_t length,
+                        weatherRecord &record);
+
+#endif
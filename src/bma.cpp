@@ -34,20 +34,40 @@ bool BMA423::begin(bma4_com_fptr_t readCallBlack,
   __devFptr.bus_read       = readCallBlack;
   __devFptr.bus_write      = writeCallBlack;
   __devFptr.delay          = delayCallBlack;
-  __devFptr.read_write_len = 8;
+  // One burst per feature block; 64 bytes plus the register address fit the
+  // Wire buffer, so the config file streams in 96 bursts instead of 768
+  __devFptr.read_write_len = BMA423_FEATURE_SIZE;
   __devFptr.resolution     = 12;
   __devFptr.feature_len    = BMA423_FEATURE_SIZE;
 
-  softReset();
+  // The sensor keeps its config file across an ESP32 reset, only upload it
+  // again after a power loss
+  bool loaded = __configLoaded();
 
-  __delayCallBlackFptr(20);
+  if (!loaded) {
+    softReset();
+    __delayCallBlackFptr(20);
+  }
 
   if (bma423_init(&__devFptr) != BMA4_OK) {
     DEBUG("BMA423 FAIL\n");
     return false;
   }
 
-  if (bma423_write_config_file(&__devFptr) != BMA4_OK) {
+  uint16_t configId = 0;
+  if (loaded && (bma423_get_config_id(&configId, &__devFptr) != BMA4_OK ||
+                 configId == 0)) {
+    loaded = false;
+  }
+
+  if (loaded) {
+    // Restore the feature config start address bma4_write_config_file would
+    // have read back
+    uint8_t asic[2] = {0, 0};
+    __readRegisterFptr(address, BMA4_RESERVED_REG_5B_ADDR, asic, 2);
+    __devFptr.asic_data.asic_lsb = asic[0] & 0x0F;
+    __devFptr.asic_data.asic_msb = asic[1];
+  } else if (bma423_write_config_file(&__devFptr) != BMA4_OK) {
     DEBUG("BMA423 Write Config FAIL\n");
     return false;
   }
@@ -68,6 +88,15 @@ bool BMA423::begin(bma4_com_fptr_t readCallBlack,
   return true;
 }
 
+bool BMA423::__configLoaded() {
+  uint8_t status = 0;
+  if (__readRegisterFptr(__devFptr.dev_addr, BMA4_INTERNAL_STAT, &status, 1) !=
+      0) {
+    return false;
+  }
+  return (status & 0x1F) == BMA4_ASIC_INITIALIZED;
+}
+
 void BMA423::softReset() {
   uint8_t reg = BMA4_RESET_ADDR;
   __writeRegisterFptr(BMA4_I2C_ADDR_PRIMARY, BMA4_RESET_SET_MASK, &reg, 1);
@@ -235,6 +264,10 @@ bool BMA423::isDoubleClick() { return (bool)(BMA423_WAKEUP_INT & __IRQ_MASK); }
 
 bool BMA423::isTilt() { return (bool)(BMA423_TILT_INT & __IRQ_MASK); }
 
+bool BMA423::isFIFOWatermark() {
+  return (bool)(BMA4_FIFO_WM_INT & __IRQ_MASK);
+}
+
 bool BMA423::isActivity() { return (bool)(BMA423_ACTIVITY_INT & __IRQ_MASK); }
 
 bool BMA423::isAnyNoMotion() {
@@ -267,6 +300,87 @@ bool BMA423::enableActivityInterrupt(bool en) {
                                           en, &__devFptr));
 }
 
+// Latched interrupts stay raised until getINT() reads the status
+bool BMA423::setLatched(bool latched) {
+  return BMA4_OK ==
+         bma4_set_interrupt_mode(latched ? BMA4_LATCH_MODE : BMA4_NON_LATCH_MODE,
+                                 &__devFptr);
+}
+
+// Streams accelerometer frames into the FIFO, downsampled by 2^downsampling
+// from the configured ODR, and raises intLine while at least watermarkFrames
+// are waiting. The FIFO overwrites its oldest frames when full.
+bool BMA423::enableFIFO(uint16_t watermarkFrames, uint8_t downsampling,
+                        uint8_t intLine) {
+  watermarkFrames = constrain(watermarkFrames, 1, BMA423_FIFO_MAX_FRAMES);
+  if (bma4_set_fifo_config(BMA4_FIFO_ALL, BMA4_DISABLE, &__devFptr) !=
+          BMA4_OK ||
+      bma4_set_accel_fifo_filter_data(BMA4_ENABLE, &__devFptr) != BMA4_OK ||
+      bma4_set_fifo_down_accel(downsampling, &__devFptr) != BMA4_OK ||
+      bma4_set_fifo_wm(watermarkFrames * BMA4_FIFO_A_LENGTH, &__devFptr) !=
+          BMA4_OK ||
+      bma4_set_fifo_config(BMA4_FIFO_ACCEL, BMA4_ENABLE, &__devFptr) !=
+          BMA4_OK ||
+      !flushFIFO()) {
+    return false;
+  }
+  return BMA4_OK == bma423_map_interrupt(intLine, BMA4_FIFO_WM_INT,
+                                         BMA4_ENABLE, &__devFptr);
+}
+
+bool BMA423::disableFIFO(uint8_t intLine) {
+  bma423_map_interrupt(intLine, BMA4_FIFO_WM_INT, BMA4_DISABLE, &__devFptr);
+  return BMA4_OK ==
+         bma4_set_fifo_config(BMA4_FIFO_ALL, BMA4_DISABLE, &__devFptr);
+}
+
+bool BMA423::flushFIFO() {
+  return BMA4_OK == bma4_set_command_register(BMA4_FIFO_FLUSH_CMD, &__devFptr);
+}
+
+// Bytes waiting in the FIFO
+uint16_t BMA423::getFIFOLength() {
+  uint16_t length = 0;
+  if (bma4_get_fifo_length(&length, &__devFptr) != BMA4_OK) {
+    return 0;
+  }
+  return length;
+}
+
+// Drains what the FIFO holds now in whole-frame bursts, so no frame is split
+// across two reads, and returns the number of samples passed to callback.
+// A failed read flushes the FIFO so the watermark line drops.
+uint16_t BMA423::readFIFO(FIFOCallback callback, void *context) {
+  uint8_t buffer[BMA423_FIFO_BURST];
+  Accel samples[BMA423_FIFO_BURST / BMA4_FIFO_A_LENGTH];
+  struct bma4_fifo_frame fifo;
+  uint16_t total     = 0;
+  uint16_t remaining = getFIFOLength();
+  remaining -= remaining % BMA4_FIFO_A_LENGTH;
+  while (remaining > 0) {
+    uint16_t burst = min(remaining, (uint16_t)BMA423_FIFO_BURST);
+    if (__readRegisterFptr(__devFptr.dev_addr, BMA4_FIFO_DATA_ADDR, buffer,
+                           burst) != 0) {
+      flushFIFO();
+      break;
+    }
+    memset(&fifo, 0, sizeof(fifo));
+    fifo.data             = buffer;
+    fifo.length           = burst;
+    fifo.fifo_data_enable = BMA4_FIFO_A_ENABLE;
+    __devFptr.fifo        = &fifo;
+    uint16_t count        = burst / BMA4_FIFO_A_LENGTH;
+    uint16_t rslt         = bma4_extract_accel(samples, &count, &__devFptr);
+    __devFptr.fifo        = NULL;
+    if (rslt == BMA4_OK && count > 0) {
+      callback(context, samples, count);
+      total += count;
+    }
+    remaining -= burst;
+  }
+  return total;
+}
+
 const char *BMA423::getActivity() {
   uint8_t activity;
   bma423_activity_output(&activity, &__devFptr);
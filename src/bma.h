@@ -20,6 +20,16 @@ enum {
 typedef struct bma4_accel Accel;
 typedef struct bma4_accel_config Acfg;
 
+// FIFO capture, accelerometer only without headers (6 bytes per frame)
+#define BMA423_FIFO_SIZE       1024
+#define BMA423_FIFO_BURST      126 // 21 frames, fits the Wire buffer
+#define BMA423_FIFO_MAX_FRAMES (BMA423_FIFO_SIZE / BMA4_FIFO_A_LENGTH)
+#define BMA4_FIFO_FLUSH_CMD    UINT8_C(0xB0)
+
+// Receives FIFO samples in batches of up to BMA423_FIFO_BURST / 6
+typedef void (*FIFOCallback)(void *context, const Accel *samples,
+                             uint16_t count);
+
 class BMA423 {
 
 public:
@@ -52,6 +62,7 @@ public:
   bool isStepCounter();
   bool isDoubleClick();
   bool isTilt();
+  bool isFIFOWatermark();
   bool isActivity();
   bool isAnyNoMotion();
 
@@ -75,7 +86,18 @@ public:
   bool enableAnyNoMotionInterrupt(bool en = true);
   bool enableActivityInterrupt(bool en = true);
 
+  bool setLatched(bool latched);
+
+  bool enableFIFO(uint16_t watermarkFrames, uint8_t downsampling = 0,
+                  uint8_t intLine = BMA4_INTR2_MAP);
+  bool disableFIFO(uint8_t intLine = BMA4_INTR2_MAP);
+  bool flushFIFO();
+  uint16_t getFIFOLength();
+  uint16_t readFIFO(FIFOCallback callback, void *context);
+
 private:
+  bool __configLoaded();
+
   bma4_com_fptr_t __readRegisterFptr;
   bma4_com_fptr_t __writeRegisterFptr;
   bma4_delay_fptr_t __delayCallBlackFptr;
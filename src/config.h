@@ -38,6 +38,8 @@
 #define UP_BTN_MASK   (BIT64(0))
 #define DOWN_BTN_MASK (BIT64(8))
 #define ACC_INT_MASK  (BIT64(14))
+#define ACC_INT_2_MASK (BIT64(13))
+#define ACC_FIFO_MASK  ACC_INT_2_MASK // line of the FIFO watermark
 #define BTN_PIN_MASK  MENU_BTN_MASK|BACK_BTN_MASK|UP_BTN_MASK|DOWN_BTN_MASK
 
 #else //V1,V1.5,V2
@@ -48,6 +50,7 @@
 #pragma message "Hardware revision is not defined at the project level, please define in config.h. Defaulting to ARDUINO_WATCHY_V20"
 
 #define ARDUINO_WATCHY_V20
+#define RTC_TYPE_PROBE // revision guessed, WatchyRTC finds the RTC at runtime
 
 #define MENU_BTN_PIN 26
 #define BACK_BTN_PIN 25
@@ -82,18 +85,90 @@
 #define BACK_BTN_MASK (BIT64(25))
 #define DOWN_BTN_MASK (BIT64(4))
 #define ACC_INT_MASK  (BIT64(14))
+#define ACC_INT_2_MASK (BIT64(12))
+// ACC_INT_2 is GPIO12, which straps the flash voltage: held high through a
+// reset it boots the 3.3 V flash at 1.8 V. The BMA423 never drives it, the
+// FIFO watermark shares ACC_INT_1 instead.
+#define ACC_FIFO_MASK  ACC_INT_MASK
 #define BTN_PIN_MASK  MENU_BTN_MASK|BACK_BTN_MASK|UP_BTN_MASK|DOWN_BTN_MASK
 
 #endif
 
 #endif
 
+// i2c, BMA423 and both RTCs support fast mode
+#define I2C_CLOCK_HZ        400000
+#define BMA423_I2C_CLOCK_HZ 400000 // 1000000 (fast mode plus) if the pull-ups allow
+#define I2C_RETRIES         2
+#define I2C_RETRY_DELAY_US  100
+#define I2C_MAX_DEVICES     4
+#define I2C_QUEUE_DEPTH     8
+#define I2C_WORKER_PRIORITY 3
+#define I2C_ASYNC_TIMEOUT_MS 50 // queued step counter read, see Watchy::init()
 //display
 #define DISPLAY_WIDTH 200
 #define DISPLAY_HEIGHT 200
 // wifi
 #define WIFI_AP_TIMEOUT 60
 #define WIFI_AP_SSID    "Watchy AP"
+#define WIFI_CONNECT_TIMEOUT 10000 // ms, background association on ticks
+// NTP
+#define NTP_SYNC_SAMPLES 4    // requests per sync, shortest round trip wins
+#define NTP_TIMEOUT_MS   1000 // max wait for each reply
+#define NTP_LOCAL_PORT   2390
+// DNS / TLS caches kept in RTC memory
+#define DNS_CACHE_ENTRIES     4
+#define DNS_CACHE_HOST_LEN    48
+#define DNS_CACHE_MIN_TTL     60    // seconds
+#define DNS_CACHE_MAX_TTL     86400 // seconds
+#define DNS_CACHE_DEFAULT_TTL 3600  // when the resolver gives no TTL
+#define DNS_TIMEOUT_MS        1000
+#define TLS_HANDSHAKE_TIMEOUT 10000 // ms
+#define TLS_SESSION_SIZE      512   // session and ticket, no peer certificate
+// Binary weather proxy, weatherURL "wxr://host:port"
+#define WEATHER_PROXY_RETRIES    3
+#define WEATHER_PROXY_TIMEOUT_MS 500
+// BLE time/weather sync, settings.bleSync
+#define BLE_SYNC_WINDOW_MS    4000 // how long to wait for a push
+#define BLE_SYNC_ADV_INTERVAL 32   // 0.625 ms units, 20 ms
+// BLE telemetry beacon, settings.beaconInterval
+#define BLE_BEACON_ADV_INTERVAL 32  // 0.625 ms units, 20 ms
+#define BLE_BEACON_DURATION_MS  100 // about 5 events on each channel
+// accelerometer screen
+#define ACCEL_VIEW_INTERVAL_MS 250 // shortest time between refreshes
+#define ACCEL_VIEW_VALUE_X     48  // window x must be a multiple of 8
+// gestures passed to handleGesture(), settings.gestureWake
+#define GESTURE_DOUBLE_TAP 0x01
+#define GESTURE_TILT       0x02
+// sleep tracking, settings.sleepTracking
+#define ACTIGRAPHY_ODR             BMA4_OUTPUT_DATA_RATE_6_25HZ
+#define ACTIGRAPHY_EPOCH_SAMPLES   375 // 60 s at 6.25 Hz
+#define ACTIGRAPHY_WATERMARK       150 // FIFO frames per wake, 24 s
+#define ACTIGRAPHY_MAX_EPOCHS      600 // 10 h, one byte each in RTC memory
+#define ACTIGRAPHY_DEADBAND        24  // LSB of summed axis change, 1 g = 1024
+#define ACTIGRAPHY_SLEEP_THRESHOLD 5000
+#define ACTIGRAPHY_ONSET_EPOCHS    10
+#define ACTIGRAPHY_START_HOUR      22
+#define ACTIGRAPHY_END_HOUR        8
+// V3 slow clock, see Watchy32KRTC.h
+#define SLOW_CLK_CAL_CYCLES     1024   // 32 kHz cycles per calibration, 31 ms
+#define SLOW_CLK_CAL_INTERVAL   60     // minute ticks between calibrations
+#define SLOW_CLK_START_ATTEMPTS 10     // 100 ms apart while the crystal starts
+#define SLOW_CLK_TICK_GUARD_US  2000   // wake this long after the minute
+#define SLOW_CLK_EARLY_MAX_US   500000 // earlier wakes sleep to the tick
+
+// seconds window of the default face, see Watchy::setSecondsWake()
+#define SECONDS_WINDOW_X        144 // x must be a multiple of 8
+#define SECONDS_WINDOW_Y        120
+#define SECONDS_WINDOW_W        56
+#define SECONDS_WINDOW_H        24
+#define SECONDS_LIGHT_SLEEP_MAX 5 // longer intervals go through deep sleep
+
+// user alarms and timers in RTC memory, see Alarms.h
+#define ALARM_SLOTS 8 // at most 8, Alarms::due() returns a bit mask
+
+// step history, completed days kept in NVS
+#define STEP_HISTORY_DAYS 30
 // menu
 #define WATCHFACE_STATE -1
 #define MAIN_MENU_STATE 0
@@ -109,12 +184,22 @@
 #define SET_DAY    4
 #define HOUR_12_24 24
 // BLE OTA
-#define BLE_DEVICE_NAME        "Watchy BLE OTA"
-#define WATCHFACE_NAME         "Watchy 7 Segment"
-#define SOFTWARE_VERSION_MAJOR 1
-#define SOFTWARE_VERSION_MINOR 0
-#define SOFTWARE_VERSION_PATCH 0
-#define HARDWARE_VERSION_MAJOR 1
-#define HARDWARE_VERSION_MINOR 0
+#define BLE_DEVICE_NAME         "Watchy BLE OTA"
+#define WATCHFACE_NAME          "Watchy 7 Segment"
+#define SOFTWARE_VERSION_MAJOR  1
+#define SOFTWARE_VERSION_MINOR  0
+#define SOFTWARE_VERSION_PATCH  0
+#define HARDWARE_VERSION_MAJOR  1
+#define HARDWARE_VERSION_MINOR  0
+#define BLE_OTA_MTU             517
+#define BLE_ACK_WINDOW          16 // stream packets per acknowledgement
+#define BLE_LEGACY_END_MS       2000 // pause that ends a whole-packet image
+#define BLE_CONN_INTERVAL_MIN   6  // 1.25 ms units
+#define BLE_CONN_INTERVAL_MAX   12
+#define OTA_RING_SIZE           16384
+#define OTA_WRITE_CHUNK         4096 // one flash sector per write
+#define OTA_QUEUE_TIMEOUT_MS    5000
+#define OTA_WRITER_PRIORITY     5
+#define OTA_INFLATE_WINDOW_BITS 12 // largest packer window accepted, 4 KB
 
 #endif
\ No newline at end of file